@@ -29,6 +29,7 @@
 #include <unistd.h>
 
 #include "AbstractConnection.h"
+#include "RspCodec.h"
 #include "Utils.h"
 
 using std::cerr;
@@ -43,9 +44,9 @@ using std::setw;
 
 //! Get the next packet from the RSP connection
 
-//! Modeled on the stub version supplied with GDB. This allows the user to
-//! replace the character read function, which is why we get stuff a character
-//! at at time.
+//! The packet has already been framed, checksummed and acknowledged by the
+//! reader thread, so we just take it from the queue, waiting if necessary.
+//! X packets have also been unescaped.
 
 //! Unlike the reference implementation, we don't deal with sequence
 //! numbers. GDB has never used them, and this implementation is only intended
@@ -59,125 +60,60 @@ using std::setw;
 bool
 AbstractConnection::getPkt (RspPacket *pkt)
 {
-  // Keep getting packets, until one is found with a valid checksum
   while (true)
     {
-      int            bufSize = pkt->getBufSize ();
-      unsigned char  checksum;		// The checksum we have computed
-      int            count;		// Index into the buffer
-      int 	     ch;		// Current character
-
-
-      // Wait around for the start character ('$'). Ignore all other
-      // characters
-      ch = getRspChar ();
-      while (ch != '$')
+      unsigned int  head = mPktHead.load (std::memory_order_relaxed);
+
+      {
+	std::unique_lock<std::mutex>  lock (mRxMutex);
+
+	// We have finished with the previous packet, so anything we held back
+	// for it can now be decoded, and any acks left are strays.
+	mAcks.clear ();
+
+	if (mHoldDecode.load (std::memory_order_relaxed))
+	  {
+	    mHoldDecode.store (false, std::memory_order_relaxed);
+	    mRxCond.notify_all ();
+	  }
+
+	mRxCond.wait (lock, [this, head] {
+	    return (head != mPktTail.load (std::memory_order_acquire))
+	      || mReaderDone.load (std::memory_order_acquire);
+	  });
+
+	// Packets already decoded are still delivered after the reader has
+	// finished.
+	if (head == mPktTail.load (std::memory_order_acquire))
+	  return  false;		// Connection failed
+      }
+
+      unsigned int  slot = head & (PKT_QUEUE_SIZE - 1);
+      int           len  = mPktLen[slot];
+
+      // Copy the EOS as well - it's convenient for non-binary data to be
+      // valid strings.
+      pkt->reserve (len + 1);
+      memcpy (pkt->data, mPktQueue[slot].data (), len + 1);
+      pkt->setLen (len);
+      mRxTime = mPktRxTime[slot];
+
+      mPktHead.store (head + 1, std::memory_order_release);
+
+      // If the queue was full, the reader thread may be waiting for space.
+      if (mPktTail.load (std::memory_order_acquire) - head == PKT_QUEUE_SIZE)
 	{
-	  if (-1 == ch)
-	    {
-	      return  false;		// Connection failed
-	    }
-	  else
-	    {
- 	      ch = getRspChar ();
-	    }
+	  std::lock_guard<std::mutex>  lock (mRxMutex);
+	  mRxCond.notify_all ();
 	}
 
-      // Read until a '#' or end of buffer is found
-      checksum =  0;
-      count    =  0;
-      while (count < bufSize - 1)
+      if (traceFlags->traceRsp())
 	{
-	  ch = getRspChar ();
-
-	  if (-1 == ch)
-	    {
-	      return  false;		// Connection failed
-	    }
-
-	  // If we hit a start of line char begin all over again
-	  if ('$' == ch)
-	    {
-	      checksum =  0;
-	      count    =  0;
-
-	      continue;
-	    }
-
-	  // Break out if we get the end of line char
-	  if ('#' == ch)
-	    {
-	      break;
-	    }
-
-	  // Update the checksum and add the char to the buffer
-	  checksum         = checksum + (unsigned char)ch;
-	  pkt->data[count] = (char)ch;
-	  count++;
+	  cout << "RSP trace: getPkt: " << *pkt << endl;
 	}
 
-      // Mark the end of the buffer with EOS - it's convenient for non-binary
-      // data to be valid strings.
-      pkt->data[count] = 0;
-      pkt->setLen (count);
-
-      // If we have a valid end of packet char, validate the checksum. If we
-      // don't it's because we ran out of buffer in the previous loop.
-      if ('#' == ch)
-	{
-	  unsigned char  xmitcsum;	// The checksum in the packet
-
-	  ch = getRspChar ();
-	  if (-1 == ch)
-	    {
-	      return  false;		// Connection failed
-	    }
-	  xmitcsum = Utils::char2Hex (ch) << 4;
-
-	  ch = getRspChar ();
-	  if (-1 == ch)
-	    {
-	      return  false;			// Connection failed
-	    }
-
-	  xmitcsum += Utils::char2Hex (ch);
-
-	  // If the checksums don't match print a warning, and put the
-	  // negative ack back to the client. Otherwise put a positive ack.
-	  if (checksum != xmitcsum)
-	    {
-	      cerr << "Warning: Bad RSP checksum: Computed 0x"
-			<< setw (2) << setfill ('0') << hex
-			<< checksum << ", received 0x" << xmitcsum
-			<< setfill (' ') << dec << endl;
-	      if (!putRspChar ('-'))		// Failed checksum
-		{
-		  return  false;		// Comms failure
-		}
-	    }
-	  else
-	    {
-	      if (!putRspChar ('+'))		// successful transfer
-		{
-		  return  false;		// Comms failure
-		}
-	      else
-		{
-		  if (traceFlags->traceRsp())
-		    {
-		      cout << "RSP trace: getPkt: " << *pkt << endl;
-		    }
-
-		  return  true;			// Success
-		}
-	    }
-	}
-      else
-	{
-	  cerr << "Warning: RSP packet overran buffer" << endl;
-	}
+      return  true;
     }
-
 }	// getPkt ()
 
 
@@ -186,7 +122,12 @@ AbstractConnection::getPkt (RspPacket *pkt)
 //! Modeled on the stub version supplied with GDB. Put out the data preceded
 //! by a '$', followed by a '#' and a one byte checksum. '$', '#', '*' and '}'
 //! are escaped by preceding them with '}' and then XORing the character with
-//! 0x20.
+//! 0x20. Runs of 4 or more identical chars are run length encoded, which
+//! greatly shortens replies for zeroed memory.
+
+//! The complete frame is built in the transmit buffer and sent with a single
+//! call to the block write function, rather than a character at a time. The
+//! body is escaped and checksummed a run at a time by RspCodec.
 
 //! @param[in] pkt  The Packet to transmit
 
@@ -197,61 +138,30 @@ AbstractConnection::putPkt (RspPacket *pkt)
 {
   int  len = pkt->getLen ();
   int  ch;				// Ack char
+  auto start = std::chrono::steady_clock::now ();
 
-  // Construct $<packet info>#<checksum>. Repeat until the GDB client
-  // acknowledges satisfactory receipt.
+  // Construct $<packet info>#<checksum>.
+  int   frameLen = buildFrame ('$', nullptr, pkt);
+  char *frame    = mTxBuf.data ();
+
+  // Repeat until the GDB client acknowledges satisfactory receipt. In
+  // no-ack mode there is no acknowledgement, so we only send once.
   do
     {
-      unsigned char checksum = 0;	// Computed checksum
-      int           count    = 0;	// Index into the buffer
+      {
+	std::lock_guard<std::mutex>  lock (mTxMutex);
 
-      if (!putRspChar ('$'))		// Start char
-	{
-	  return  false;		// Comms failure
-	}
+	if (!putRspBlockRaw (frame, frameLen))
+	  {
+	    return  false;		// Comms failure
+	  }
+      }
 
-
-      // Body of the packet
-      for (count = 0; count < len; count++)
-	{
-	  unsigned char  ch = pkt->data[count];
-
-	  // Check for escaped chars
-	  if (('$' == ch) || ('#' == ch) || ('*' == ch) || ('}' == ch))
-	    {
-	      ch       ^= 0x20;
-	      checksum += (unsigned char)'}';
-	      if (!putRspChar ('}'))
-		{
-		  return  false;	// Comms failure
-		}
-
-	    }
-
-	  checksum += ch;
-	  if (!putRspChar (ch))
-	    {
-	      return  false;		// Comms failure
-	    }
-	}
-
-      if (!putRspChar ('#'))		// End char
-	{
-	  return  false;		// Comms failure
-	}
-
-      // Computed checksum
-      if (!putRspChar (Utils::hex2Char (checksum >> 4)))
-	{
-	  return  false;		// Comms failure
-	}
-      if (!putRspChar (Utils::hex2Char (checksum % 16)))
-	{
-	  return  false;		// Comms failure
-	}
+      if (mNoAckMode.load (std::memory_order_relaxed))
+	break;
 
       // Check for ack of connection failure
-      ch = getRspChar ();
+      ch = getAck ();
       if (-1 == ch)
 	{
 	  return  false;		// Comms failure
@@ -259,6 +169,9 @@ AbstractConnection::putPkt (RspPacket *pkt)
     }
   while ('+' != ch);
 
+  mTxTime  += std::chrono::steady_clock::now () - start;
+  mTxBytes += len;
+
   if (traceFlags->traceRsp())
     {
       cout << "RSP trace: putPkt: " << *pkt << endl;
@@ -269,10 +182,106 @@ AbstractConnection::putPkt (RspPacket *pkt)
 }	// putPkt ()
 
 
+//! Put an asynchronous notification out on the RSP connection
+
+//! Used in non-stop mode to tell GDB the target has stopped. A notification
+//! is framed like a packet, but starts with '%' and the notification name,
+//! and is never acknowledged, so is only sent once.
+
+//!   %<name>:<packet info>#<checksum>
+
+//! @param[in] name  The name of the notification (e.g. "Stop").
+//! @param[in] pkt   The body of the notification.
+
+//! @return  TRUE to indicate success, FALSE otherwise (means a communications
+//!          failure).
+
+bool
+AbstractConnection::putNotification (const char *name,
+				     RspPacket  *pkt)
+{
+  auto start    = std::chrono::steady_clock::now ();
+  int  frameLen = buildFrame ('%', name, pkt);
+
+  {
+    std::lock_guard<std::mutex>  lock (mTxMutex);
+
+    if (!putRspBlockRaw (mTxBuf.data (), frameLen))
+      return  false;			// Comms failure
+  }
+
+  mTxTime  += std::chrono::steady_clock::now () - start;
+  mTxBytes += pkt->getLen ();
+
+  if (traceFlags->traceRsp())
+    {
+      cout << "RSP trace: putNotification: " << name << ":" << *pkt << endl;
+    }
+
+  return  true;
+
+}	// putNotification ()
+
+
+//! Build a frame in the transmit buffer
+
+//! Utility routine for putPkt () and putNotification (). The body is
+//! escaped and run length encoded, and the checksum appended. The buffer is
+//! grown if need be.
+
+//! @param[in] start  The start char ('$' for a packet, '%' for a
+//!                   notification).
+//! @param[in] name   The notification name, or nullptr for a packet.
+//! @param[in] pkt    The body of the frame.
+
+//! @return  The length of the frame.
+
+int
+AbstractConnection::buildFrame (char        start,
+				const char *name,
+				RspPacket  *pkt)
+{
+  int  len     = pkt->getLen ();
+  int  nameLen = (nullptr == name) ? 0 : strlen (name);
+
+  // Worst case every char is escaped, plus the start char, the name and
+  // ':', '#' and two checksum chars.
+  std::size_t  maxFrameLen = len * 2 + nameLen + 5;
+
+  if (mTxBuf.size () < maxFrameLen)
+    mTxBuf.resize (maxFrameLen);
+
+  char     *frame    = mTxBuf.data ();
+  uint8_t   checksum = 0;		// Computed checksum
+  int       frameLen = 0;		// Index into the frame
+
+  frame[frameLen++] = start;		// Start char
+
+  if (nullptr != name)
+    {
+      frameLen += RspCodec::escape (name, nameLen, frame + frameLen,
+				    checksum);
+      frame[frameLen++] = ':';
+      checksum += ':';
+    }
+
+  frameLen += RspCodec::encode (pkt->data, len, frame + frameLen, checksum);
+  frame[frameLen++] = '#';		// End char
+
+  // Computed checksum
+  frame[frameLen++] = Utils::hex2Char (checksum >> 4);
+  frame[frameLen++] = Utils::hex2Char (checksum % 16);
+
+  return  frameLen;
+
+}	// buildFrame ()
+
+
 //! Put a single character out on the RSP connection
 
 //! Potentially we can have an OS specific implemenation of the underlying
-//! routine.
+//! routine. Used by the reader thread for acknowledgements, so must not
+//! interleave with a packet being sent by putPkt ().
 
 //! @param[in] c  The character to put out
 //! @return  TRUE if char sent OK, FALSE if not (communications failure)
@@ -280,82 +289,434 @@ AbstractConnection::putPkt (RspPacket *pkt)
 bool
 AbstractConnection::putRspChar (char  c)
 {
+  std::lock_guard<std::mutex>  lock (mTxMutex);
+
   return  putRspCharRaw (c);
 
 }	// putRspChar ()
 
 
+//! Get the next acknowledgement from the client
 
-//! Get a single character from the RSP connection with buffering
+//! Utility routine for putPkt ().  Acknowledgements are queued by the reader
+//! thread, and we only sleep if there are none.
 
-//! Utility routine for use by other functions.  This is built on the raw
-//! read function.
+//! @return  The acknowledgement char ('+' or '-') or -1 on failure
 
-//! This function will first return the possibly buffered character (buffering
-//! caused by calling 'haveBreak'.  If the character read is the break
-//! character then we record this fact, and fetch the next character.
+int
+AbstractConnection::getAck ()
+{
+  std::unique_lock<std::mutex>  lock (mRxMutex);
 
-//! @return  The character received or -1 on failure
+  mRxCond.wait (lock, [this] {
+      return !mAcks.empty () || mReaderDone.load (std::memory_order_acquire);
+    });
 
-int
-AbstractConnection::getRspChar ()
+  if (mAcks.empty ())
+    return  -1;
+
+  int  ch = mAcks.front ();
+
+  mAcks.pop_front ();
+  return  ch;
+
+}	// getAck ()
+
+
+//! Wait for a free slot in the packet queue.
+
+//! Utility routine for the reader thread, called at the start of each
+//! packet. We also wait while decoding is held after QStartNoAckMode.
+
+//! @return  TRUE if there is a free slot, FALSE if we have been asked to
+//!          stop.
+
+bool
+AbstractConnection::waitForPktSlot ()
+{
+  unsigned int  tail = mPktTail.load (std::memory_order_relaxed);
+
+  if ((tail - mPktHead.load (std::memory_order_acquire) != PKT_QUEUE_SIZE)
+      && !mHoldDecode.load (std::memory_order_relaxed))
+    return  true;
+
+  std::unique_lock<std::mutex>  lock (mRxMutex);
+
+  mRxCond.wait (lock, [this, tail] {
+      return ((tail - mPktHead.load (std::memory_order_acquire)
+	       != PKT_QUEUE_SIZE)
+	      && !mHoldDecode.load (std::memory_order_relaxed))
+	|| mReaderStop.load (std::memory_order_relaxed);
+    });
+
+  return  !mReaderStop.load (std::memory_order_relaxed);
+
+}	// waitForPktSlot ()
+
+
+//! Queue the packet which has been decoded into the tail slot.
+
+//! Utility routine for the reader thread. Binary data in X, vFlashWrite and
+//! qSearch:memory packets is unescaped here, so this is not left to the
+//! server. The header of these packets never contains escapes, so the whole
+//! packet can be unescaped.
+
+//! @param[in] len  The number of chars in the packet.
+
+void
+AbstractConnection::queuePkt (int  len)
 {
-  int ch;
+  unsigned int  tail = mPktTail.load (std::memory_order_relaxed);
+  unsigned int  slot = tail & (PKT_QUEUE_SIZE - 1);
+  char         *data = mPktQueue[slot].data ();
 
-  if (mNumGetBufChars > 1)
-    cerr << "Warning: Too many cached characters ("
-	 << dec << mNumGetBufChars << ")" << endl;
+  static const char * const  binaryPkts[] = {
+    "X", "vFlashWrite:", "qSearch:memory:"
+  };
 
-  if (mNumGetBufChars > 0)
+  for (const char *prefix : binaryPkts)
     {
-      ch = mGetCharBuf;
-      mNumGetBufChars = 0;
+      int  prefixLen = strlen (prefix);
+
+      if ((len >= prefixLen) && (0 == memcmp (data, prefix, prefixLen)))
+	{
+	  len = RspCodec::unescape (data, len);
+	  break;
+	}
     }
-  else
-    ch = getRspCharRaw (true);
 
-  return  ch;
+  data[len]        = 0;
+  mPktLen[slot]    = len;
+  mPktRxTime[slot] = std::chrono::steady_clock::now ();
 
-}	// getRspChar ()
+  // Once the server has agreed to no-ack mode, the client will stop
+  // expecting acks. So decode no more until the server has replied.
+  if (0 == strcmp (data, "QStartNoAckMode"))
+    mHoldDecode.store (true, std::memory_order_relaxed);
 
+  std::lock_guard<std::mutex>  lock (mRxMutex);
+  mPktTail.store (tail + 1, std::memory_order_release);
+  mRxCond.notify_all ();
 
-//! Have we received a break character.
+}	// queuePkt ()
 
-//! Since we only check fo this between packets, we don't have to worry about
-//! being in the middle of a packet.
 
-//! @Note  We only peek, so no character is actually consumed from the input.
+//! The reader thread.
 
-//! @return  TRUE if we have received a break character, FALSE otherwise.
+//! This is the first stage of the pipeline. Repeatedly read as many
+//! characters as are available, and decode packets from them into the
+//! packet queue.
 
-bool
-AbstractConnection::haveBreak ()
+//! Modeled on the stub version supplied with GDB. A packet is any
+//! characters between '$' and '#', followed by a two digit checksum. If the
+//! checksum is good the packet is acknowledged and queued, otherwise it is
+//! negatively acknowledged and dropped (in no-ack mode neither ack is sent).
+//! A '$' within a packet starts it all over again.
+
+//! Between packets, we keep any acknowledgements for putPkt (). A BREAK is
+//! flagged immediately. Anything else is ignored. A 0x03 within a packet
+//! (for example in binary data) is just data.
+
+void
+AbstractConnection::readerThread ()
 {
-  if (!mHavePendingBreak
-      && mNumGetBufChars == 0)
+  enum { BETWEEN, IN_PACKET, IN_CSUM1, IN_CSUM2 }  state = BETWEEN;
+
+  std::vector<char> *pktBuf = nullptr;	// Where we are decoding the packet
+  int            len      = 0;		// Chars decoded
+  bool           overrun  = false;	// Too many chars for the buffer?
+  unsigned char  checksum = 0;		// The checksum we have computed
+  unsigned char  xmitcsum = 0;		// The checksum in the packet
+
+  while (!mReaderStop.load (std::memory_order_relaxed))
     {
-      // Non-blocking read to possibly get a character.
+      int  count = getRspBlockRaw (mRxBuf, RX_BUF_SIZE);
 
-      int nextChar = getRspCharRaw (false);
+      if (count <= 0)
+	break;				// Connection closed or failed
 
-      if (nextChar != -1)
+      for (int  i = 0; i < count; i++)
 	{
-	  if (nextChar == BREAK_CHAR)
-	    mHavePendingBreak = true;
-	  else
+	  char  ch = mRxBuf[i];
+
+	  switch (state)
 	    {
-	      mGetCharBuf = nextChar;
-	      mNumGetBufChars = 1;
+	    case BETWEEN:
+	      if (BREAK_CHAR == ch)
+		mBreakFlag.store (true, std::memory_order_release);
+	      else if (('+' == ch) || ('-' == ch))
+		{
+		  std::lock_guard<std::mutex>  lock (mRxMutex);
+		  mAcks.push_back (ch);
+		  mRxCond.notify_all ();
+		}
+	      else if ('$' == ch)
+		{
+		  if (!waitForPktSlot ())
+		    goto done;		// Asked to stop
+
+		  unsigned int  tail =
+		    mPktTail.load (std::memory_order_relaxed);
+
+		  pktBuf   = &(mPktQueue[tail & (PKT_QUEUE_SIZE - 1)]);
+		  len      = 0;
+		  overrun  = false;
+		  checksum = 0;
+		  state    = IN_PACKET;
+		}
+	      break;
+
+	    case IN_PACKET:
+	      if ('$' == ch)
+		{
+		  len      = 0;
+		  overrun  = false;
+		  checksum = 0;
+		}
+	      else if ('#' == ch)
+		state = IN_CSUM1;
+	      else
+		{
+		  // Take the whole run of chars up to the next '$' or '#'
+		  // in one go.
+		  std::size_t  run = RspCodec::findFrameEnd (mRxBuf + i,
+							     count - i);
+
+		  checksum += RspCodec::checksum (mRxBuf + i, run);
+
+		  // Leave space for an EOS, growing the buffer if need be.
+		  while (!overrun
+			 && ((std::size_t) len + run >= pktBuf->size ()))
+		    {
+		      if (pktBuf->size () < MAX_PKT_SIZE)
+			pktBuf->resize (pktBuf->size () * 2);
+		      else
+			overrun = true;
+		    }
+
+		  if (!overrun)
+		    {
+		      memcpy (pktBuf->data () + len, mRxBuf + i, run);
+		      len += run;
+		    }
+
+		  i += run - 1;
+		}
+	      break;
+
+	    case IN_CSUM1:
+	      xmitcsum = Utils::char2Hex (ch) << 4;
+	      state    = IN_CSUM2;
+	      break;
+
+	    case IN_CSUM2:
+	      xmitcsum += Utils::char2Hex (ch);
+	      state     = BETWEEN;
+
+	      if (overrun)
+		{
+		  cerr << "Warning: RSP packet overran buffer" << endl;
+		}
+	      else if (checksum != xmitcsum)
+		{
+		  // Print a warning, and put the negative ack back to the
+		  // client.
+		  cerr << "Warning: Bad RSP checksum: Computed 0x"
+		       << setw (2) << setfill ('0') << hex
+		       << (int) checksum << ", received 0x"
+		       << (int) xmitcsum << setfill (' ') << dec << endl;
+
+		  if (!mNoAckMode.load (std::memory_order_relaxed)
+		      && !putRspChar ('-'))
+		    goto done;		// Comms failure
+		}
+	      else
+		{
+		  if (!mNoAckMode.load (std::memory_order_relaxed)
+		      && !putRspChar ('+'))
+		    goto done;		// Comms failure
+
+		  queuePkt (len);
+		}
+	      break;
 	    }
 	}
     }
 
-  if (mHavePendingBreak)
-    {
-      mHavePendingBreak = false;
-      return true;
-    }
-  else
-    return false;
+ done:
+  std::lock_guard<std::mutex>  lock (mRxMutex);
+  mReaderDone.store (true, std::memory_order_release);
+  mRxCond.notify_all ();
+
+}	// readerThread ()
+
+
+//! Start the reader thread for a new client connection.
+
+//! Any previous reader must have been stopped. A new client starts off using
+//! acknowledgements.
+
+void
+AbstractConnection::startReader ()
+{
+  for (unsigned int  i = 0; i < PKT_QUEUE_SIZE; i++)
+    if (mPktQueue[i].empty ())
+      mPktQueue[i].resize (RX_BUF_SIZE);
+
+  mPktHead.store (0);
+  mPktTail.store (0);
+  mAcks.clear ();
+  mHoldDecode.store (false);
+  mNoAckMode.store (false);
+  mBreakFlag.store (false);
+  mReaderDone.store (false);
+  mReaderStop.store (false);
+
+  mReader = std::thread (&AbstractConnection::readerThread, this);
+
+}	// startReader ()
+
+
+//! Stop the reader thread.
+
+//! The subclass must already have done whatever is needed to make a blocked
+//! raw read return.  Any packets left in the queue are discarded, so
+//! nothing from an old client is seen by a new one.
+
+void
+AbstractConnection::stopReader ()
+{
+  {
+    std::lock_guard<std::mutex>  lock (mRxMutex);
+    mReaderStop.store (true);
+    mRxCond.notify_all ();
+  }
+
+  if (mReader.joinable ())
+    mReader.join ();
+
+  mPktHead.store (0);
+  mPktTail.store (0);
+  mAcks.clear ();
+  mHoldDecode.store (false);
+  mBreakFlag.store (false);
+  mReaderDone.store (true);
+
+}	// stopReader ()
+
+
+//! Can a new client connection be made once this one closes?
+
+//! True for most connections. A connection handed a client which has
+//! already been accepted elsewhere (for example by a SessionManager) serves
+//! only that client.
+
+//! @return  TRUE if rspConnect () may be called again after rspClose ().
+
+bool
+AbstractConnection::canReconnect ()
+{
+  return  true;
+
+}	// canReconnect ()
+
+
+//! Set whether we are in no-ack mode.
+
+//! Once GDB has agreed to QStartNoAckMode, packets are neither acknowledged
+//! by us, nor do we wait for GDB to acknowledge our packets. This must be
+//! turned off again for each new client connection.
+
+//! @param[in] noAckMode  TRUE to stop using acknowledgements, FALSE to use
+//!                       them.
+
+void
+AbstractConnection::setNoAckMode (bool  noAckMode)
+{
+  mNoAckMode.store (noAckMode, std::memory_order_relaxed);
+
+}	// setNoAckMode ()
+
+
+//! Have we received a break character.
+
+//! The reader thread sets a flag as soon as a break arrives between packets,
+//! so this is just a check and clear of that flag, with no system calls.
+
+//! @return  TRUE if we have received a break character, FALSE otherwise.
+
+bool
+AbstractConnection::haveBreak ()
+{
+  return  mBreakFlag.load (std::memory_order_relaxed)
+    && mBreakFlag.exchange (false, std::memory_order_acquire);
 
 }	// haveBreak ()
+
+
+//! Is there a packet waiting for getPkt ()?
+
+//! Lets the server deal with packets from GDB while the target runs in
+//! non-stop mode, without blocking if there are none.
+
+//! @return  TRUE if getPkt () would return a packet without waiting.
+
+bool
+AbstractConnection::havePkt ()
+{
+  return  mPktHead.load (std::memory_order_relaxed)
+    != mPktTail.load (std::memory_order_acquire);
+
+}	// havePkt ()
+
+
+//! Get the break flag.
+
+//! Lets a target poll for a break from within a long run, just by looking at
+//! this flag.  It must not be cleared by the target: that is left to
+//! haveBreak ().
+
+//! @return  A pointer to the flag set by the reader thread.
+
+const std::atomic<bool> *
+AbstractConnection::breakFlag () const
+{
+  return  &mBreakFlag;
+
+}	// breakFlag ()
+
+
+//! When was the last packet returned by getPkt () decoded?
+
+//! @return  The time the reader thread queued the packet.
+
+std::chrono::steady_clock::time_point
+AbstractConnection::rxTime () const
+{
+  return  mRxTime;
+
+}	// rxTime ()
+
+
+//! How long have we spent sending packets?
+
+//! @return  The total time spent in putPkt (), including waiting for acks.
+
+std::chrono::steady_clock::duration
+AbstractConnection::txTime () const
+{
+  return  mTxTime;
+
+}	// txTime ()
+
+
+//! How many bytes have we sent?
+
+//! @return  The total payload bytes of all the packets sent by putPkt ().
+
+uint64_t
+AbstractConnection::txBytes () const
+{
+  return  mTxBytes;
+
+}	// txBytes ()
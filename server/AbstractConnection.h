@@ -20,14 +20,31 @@
 #ifndef ABSTRACT_CONNECTION_H
 #define ABSTRACT_CONNECTION_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "RspPacket.h"
 #include "TraceFlags.h"
 
 
 //! Class implementing the RSP connection listener
 
-//! This class is entirely passive. It is up to the caller to determine that a
-//! packet will become available before calling ::getPkt ().
+//! All reading from the client is done by a separate reader thread. This is
+//! the first stage of a two stage pipeline: it frames each packet, checks
+//! its checksum, acknowledges it and (for binary X packets) unescapes it,
+//! then queues it for ::getPkt (). So the next packet is ready by the time
+//! the server has finished with the current one, for example while a large
+//! memory write is applied to the target.
+
+//! The reader thread also spots any BREAK (ctrl-C) between packets and
+//! raises an atomic flag, which the server and targets can check without
+//! any system calls. Acknowledgements from the client are queued separately
+//! for ::putPkt ().
 
 class AbstractConnection
 {
@@ -41,6 +58,7 @@ public:
   // Public interface: manage client connections
 
   virtual bool  rspConnect () = 0;
+  virtual bool  canReconnect ();
   virtual void  rspClose () = 0;
   virtual bool  isConnected () = 0;
 
@@ -48,10 +66,27 @@ public:
 
   virtual bool  getPkt (RspPacket *pkt);
   virtual bool  putPkt (RspPacket *pkt);
+  bool          havePkt ();
+
+  // Send an asynchronous notification (non-stop mode)
+
+  bool  putNotification (const char *name,
+			 RspPacket  *pkt);
 
   // Check for a break (ctrl-C)
 
   virtual bool  haveBreak ();
+  const std::atomic<bool> * breakFlag () const;
+
+  // Turn acknowledgement of packets on or off (QStartNoAckMode)
+
+  void  setNoAckMode (bool  noAckMode);
+
+  // Statistics for the server
+
+  std::chrono::steady_clock::time_point  rxTime () const;
+  std::chrono::steady_clock::duration    txTime () const;
+  uint64_t  txBytes () const;
 
 protected:
 
@@ -59,10 +94,21 @@ protected:
 
   TraceFlags *traceFlags;
 
-  // Internal OS specific routines to handle individual chars.
+  // Internal OS specific routines to handle individual chars and blocks of
+  // chars.
 
   virtual bool  putRspCharRaw (char  c) = 0;
-  virtual int   getRspCharRaw (bool blocking) = 0;
+  virtual bool  putRspBlockRaw (const char *buf,
+				int         len) = 0;
+  virtual int   getRspBlockRaw (char *buf,
+				int   maxLen) = 0;
+
+  // Start and stop the reader thread when a client connects and
+  // disconnects. The subclass must make any blocked getRspBlockRaw () call
+  // return before stopping the reader.
+
+  void  startReader ();
+  void  stopReader ();
 
 private:
 
@@ -70,20 +116,118 @@ private:
 
   static const int BREAK_CHAR = 3;
 
-  //! Has a BREAK arrived?
+  //! Has a BREAK arrived? Set by the reader thread, cleared by haveBreak ().
+
+  std::atomic<bool>  mBreakFlag;
+
+  //! Have we negotiated QStartNoAckMode with the client? Read by the reader
+  //! thread when deciding whether to acknowledge a packet.
+
+  std::atomic<bool>  mNoAckMode;
+
+  //! Size of the buffer for raw reads by the reader thread.
+
+  static const int RX_BUF_SIZE = 16384;
+
+  //! The largest packet we will receive, including a terminating EOS. Well
+  //! beyond any PacketSize we advertise, just to guard against garbage.
+
+  static const int MAX_PKT_SIZE = 1 << 20;
+
+  //! Buffer for raw reads by the reader thread.
+
+  char  mRxBuf[RX_BUF_SIZE];
+
+  //! Number of packets which may be decoded ahead of the server. Must be a
+  //! power of 2, so the free running indices can be masked.
+
+  static const unsigned int PKT_QUEUE_SIZE = 4;
+
+  //! Decoded packets waiting for getPkt (), each with a terminating EOS.
+  //! Each buffer is grown as needed, up to MAX_PKT_SIZE, and reused.
+
+  std::vector<char>  mPktQueue[PKT_QUEUE_SIZE];
+
+  //! The length of each decoded packet in mPktQueue.
+
+  int  mPktLen[PKT_QUEUE_SIZE];
+
+  //! When each packet in mPktQueue was decoded.
+
+  std::chrono::steady_clock::time_point  mPktRxTime[PKT_QUEUE_SIZE];
+
+  //! When the packet last returned by getPkt () was decoded.
+
+  std::chrono::steady_clock::time_point  mRxTime;
+
+  //! Total time spent in putPkt (), including waiting for acks.
+
+  std::chrono::steady_clock::duration  mTxTime;
+
+  //! Total payload bytes sent by putPkt ().
+
+  uint64_t  mTxBytes;
+
+  //! Free running index of the next packet to take from the queue. Only
+  //! written by getPkt ().
+
+  std::atomic<unsigned int>  mPktHead;
+
+  //! Free running index of the next free packet slot. Only written by the
+  //! reader thread.
+
+  std::atomic<unsigned int>  mPktTail;
+
+  //! Acknowledgements ('+' or '-') received from the client, but not yet
+  //! consumed by putPkt (). Guarded by mRxMutex.
+
+  std::deque<char>  mAcks;
+
+  //! Set by the reader thread when it has queued QStartNoAckMode, so it
+  //! does not acknowledge any following packet until the server has
+  //! replied and called setNoAckMode (). Cleared by getPkt ().
+
+  std::atomic<bool>  mHoldDecode;
+
+  //! Set by the reader thread when the connection has failed or closed.
+
+  std::atomic<bool>  mReaderDone;
+
+  //! Set to ask the reader thread to stop.
+
+  std::atomic<bool>  mReaderStop;
+
+  //! Mutex and condition variable, used to sleep when the packet queue is
+  //! empty (getPkt), full (reader thread) or held, and when waiting for an
+  //! acknowledgement.
+
+  std::mutex               mRxMutex;
+  std::condition_variable  mRxCond;
+
+  //! The reader thread
+
+  std::thread  mReader;
+
+  //! Serializes writes to the client, since acknowledgements are sent by the
+  //! reader thread.
 
-  bool mHavePendingBreak;
+  std::mutex  mTxMutex;
 
-  //! The buffered char for get RspChar
-  int  mGetCharBuf;
+  //! Transmit buffer, in which complete frames are built by putPkt. Reused
+  //! between packets and grown as needed.
 
-  //! Count of how many buffered chars we have
-  int  mNumGetBufChars;
+  std::vector<char>  mTxBuf;
 
-  // Internal routines to handle individual chars
+  // Internal routines
 
   bool  putRspChar (char  c);
-  int   getRspChar ();
+  int   buildFrame (char        start,
+		    const char *name,
+		    RspPacket  *pkt);
+  int   getAck ();
+  bool  waitForPktSlot ();
+  void  queuePkt (int  len);
+  void  readerThread ();
 };	// AbstractConnection ()
 
 // Default implementation of the destructor.
@@ -97,8 +241,15 @@ AbstractConnection::~AbstractConnection ()
 inline
 AbstractConnection::AbstractConnection (TraceFlags *_traceFlags) :
   traceFlags (_traceFlags),
-  mHavePendingBreak (false),
-  mNumGetBufChars (0)
+  mBreakFlag (false),
+  mNoAckMode (false),
+  mTxTime (std::chrono::steady_clock::duration::zero ()),
+  mTxBytes (0),
+  mPktHead (0),
+  mPktTail (0),
+  mHoldDecode (false),
+  mReaderDone (true),
+  mReaderStop (false)
 {
   // Nothing.
 }
@@ -0,0 +1,626 @@
+// GDB agent expression interpreter: implementation
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "AgentExpr.h"
+#include "ITarget.h"
+#include "Utils.h"
+
+
+//! Constructor
+
+//! The expression starts off empty, which is an error to evaluate.
+
+AgentExpr::AgentExpr ()
+{
+  // Nothing.
+
+}	// AgentExpr ()
+
+
+//! Destructor
+
+AgentExpr::~AgentExpr ()
+{
+  // Nothing.
+
+}	// ~AgentExpr ()
+
+
+//! Read the expression from a packet
+
+//! The expression is given as its length in bytes, a comma and the bytes
+//! as pairs of hex digits, as in the conditions of a Z packet:
+
+//!   <length>,<bytecode>
+
+//! @param[in,out] str  The expression. Updated to point to the first char
+//!                     after it.
+//! @return  TRUE if the expression was read, FALSE if it was malformed.
+
+bool
+AgentExpr::parse (const char * &str)
+{
+  char          *end;
+  unsigned long  len = strtoul (str, &end, 16);
+
+  if ((end == str) || (',' != *end) || (0 == len))
+    return  false;
+
+  mBytes.clear ();
+  str = end + 1;
+
+  for (unsigned long  i = 0; i < len; i++)
+    {
+      uint8_t  hi = Utils::char2Hex (str[0]);
+
+      if (hi > 0xf)
+	return  false;
+
+      uint8_t  lo = Utils::char2Hex (str[1]);
+
+      if (lo > 0xf)
+	return  false;
+
+      mBytes.push_back ((hi << 4) | lo);
+      str += 2;
+    }
+
+  return  true;
+
+}	// parse ()
+
+
+//! Evaluate the expression
+
+//! Any error, such as a bad opcode, running off the end of the bytecode,
+//! over or underflowing the stack, dividing by zero or failing to read a
+//! register or memory, stops the evaluation.
+
+//! The commands of a dprintf are evaluated with somewhere to put what
+//! printf writes. They need not leave a value on the stack. Without
+//! somewhere to put it, printf is an error.
+
+//! @param[in]     cpu     The target to read registers and memory from.
+//! @param[out]    result  The value on top of the stack at the end, or zero
+//!                        if a command left the stack empty.
+//! @param[in,out] out     If not nullptr, printf output is appended here.
+//! @return  TRUE if the expression was evaluated, FALSE on any error.
+
+bool
+AgentExpr::eval (const ITarget *cpu,
+		 uint64_t      &result,
+		 std::string   *out) const
+{
+  uint64_t     stack[STACK_MAX];
+  std::size_t  sp = 0;			// Number of values on the stack
+  std::size_t  pc = 0;			// Offset of the next opcode
+
+  for (int  steps = 0; steps < MAX_STEPS; steps++)
+    {
+      if (pc >= mBytes.size ())
+	return  false;
+
+      uint8_t   op = mBytes[pc++];
+      uint64_t  val;
+      uint64_t  a;
+      uint64_t  b;
+
+      switch (op)
+	{
+	case OP_ADD:
+	case OP_SUB:
+	case OP_MUL:
+	case OP_DIV_SIGNED:
+	case OP_DIV_UNSIGNED:
+	case OP_REM_SIGNED:
+	case OP_REM_UNSIGNED:
+	case OP_LSH:
+	case OP_RSH_SIGNED:
+	case OP_RSH_UNSIGNED:
+	case OP_BIT_AND:
+	case OP_BIT_OR:
+	case OP_BIT_XOR:
+	case OP_EQUAL:
+	case OP_LESS_SIGNED:
+	case OP_LESS_UNSIGNED:
+	  // Binary operations, a <op> b, with b on top of the stack.
+	  if (sp < 2)
+	    return  false;
+
+	  a = stack[sp - 2];
+	  b = stack[sp - 1];
+	  sp--;
+
+	  switch (op)
+	    {
+	    case OP_ADD:  val = a + b; break;
+	    case OP_SUB:  val = a - b; break;
+	    case OP_MUL:  val = a * b; break;
+
+	    case OP_DIV_SIGNED:
+	    case OP_REM_SIGNED:
+	      if (0 == b)
+		return  false;
+
+	      // The one signed division which overflows
+	      if ((uint64_t) -1 == b)
+		val = (OP_DIV_SIGNED == op) ? -a : 0;
+	      else if (OP_DIV_SIGNED == op)
+		val = (int64_t) a / (int64_t) b;
+	      else
+		val = (int64_t) a % (int64_t) b;
+
+	      break;
+
+	    case OP_DIV_UNSIGNED:
+	    case OP_REM_UNSIGNED:
+	      if (0 == b)
+		return  false;
+
+	      val = (OP_DIV_UNSIGNED == op) ? a / b : a % b;
+	      break;
+
+	    case OP_LSH:
+	      val = (b < 64) ? a << b : 0;
+	      break;
+
+	    case OP_RSH_SIGNED:
+	      val = (int64_t) a >> ((b < 64) ? b : 63);
+	      break;
+
+	    case OP_RSH_UNSIGNED:
+	      val = (b < 64) ? a >> b : 0;
+	      break;
+
+	    case OP_BIT_AND:       val = a & b;                       break;
+	    case OP_BIT_OR:        val = a | b;                       break;
+	    case OP_BIT_XOR:       val = a ^ b;                       break;
+	    case OP_EQUAL:         val = (a == b) ? 1 : 0;            break;
+	    case OP_LESS_SIGNED:   val = ((int64_t) a < (int64_t) b); break;
+	    default:               val = (a < b) ? 1 : 0;             break;
+	    }
+
+	  stack[sp - 1] = val;
+	  break;
+
+	case OP_LOG_NOT:
+	case OP_BIT_NOT:
+	  if (sp < 1)
+	    return  false;
+
+	  stack[sp - 1] = (OP_LOG_NOT == op) ? (0 == stack[sp - 1])
+	    : ~stack[sp - 1];
+	  break;
+
+	case OP_EXT:
+	case OP_ZERO_EXT:
+	  // Sign or zero extend the top of the stack from n bits.
+	  if ((sp < 1) || !operand (pc, 1, val) || (0 == val) || (val > 64))
+	    return  false;
+
+	  pc++;
+
+	  if (val < 64)
+	    {
+	      uint64_t  mask = ((uint64_t) 1 << val) - 1;
+	      uint64_t  sign = (uint64_t) 1 << (val - 1);
+
+	      stack[sp - 1] &= mask;
+
+	      if ((OP_EXT == op) && (0 != (stack[sp - 1] & sign)))
+		stack[sp - 1] |= ~mask;
+	    }
+
+	  break;
+
+	case OP_REF8:
+	case OP_REF16:
+	case OP_REF32:
+	case OP_REF64:
+	  {
+	    // Replace the address on top of the stack by the value there,
+	    // which is little-endian.
+	    std::size_t  n = (std::size_t) 1 << (op - OP_REF8);
+	    uint8_t      buf[8];
+
+	    if ((sp < 1)
+		|| (n != cpu->read ((uint32_t) stack[sp - 1], buf, n)))
+	      return  false;
+
+	    val = 0;
+
+	    for (std::size_t  i = n; i > 0; i--)
+	      val = (val << 8) | buf[i - 1];
+
+	    stack[sp - 1] = val;
+	    break;
+	  }
+
+	case OP_IF_GOTO:
+	case OP_GOTO:
+	  // The operand is the offset of the opcode to go to.
+	  if (!operand (pc, 2, val) || ((OP_IF_GOTO == op) && (sp < 1)))
+	    return  false;
+
+	  if ((OP_GOTO == op) || (0 != stack[--sp]))
+	    pc = val;
+	  else
+	    pc += 2;
+
+	  break;
+
+	case OP_CONST8:
+	case OP_CONST16:
+	case OP_CONST32:
+	case OP_CONST64:
+	  {
+	    int  n = 1 << (op - OP_CONST8);
+
+	    if ((sp >= STACK_MAX) || !operand (pc, n, val))
+	      return  false;
+
+	    stack[sp++] = val;
+	    pc += n;
+	    break;
+	  }
+
+	case OP_REG:
+	  {
+	    uint_reg_t  reg;
+
+	    if ((sp >= STACK_MAX) || !operand (pc, 2, val)
+		|| (0 == cpu->readRegister ((int) val, reg)))
+	      return  false;
+
+	    stack[sp++] = reg;
+	    pc += 2;
+	    break;
+	  }
+
+	case OP_END:
+	  if ((sp < 1) && (nullptr == out))
+	    return  false;
+
+	  result = (sp < 1) ? 0 : stack[sp - 1];
+	  return  true;
+
+	case OP_DUP:
+	  if ((sp < 1) || (sp >= STACK_MAX))
+	    return  false;
+
+	  stack[sp] = stack[sp - 1];
+	  sp++;
+	  break;
+
+	case OP_POP:
+	  if (sp < 1)
+	    return  false;
+
+	  sp--;
+	  break;
+
+	case OP_SWAP:
+	  if (sp < 2)
+	    return  false;
+
+	  val           = stack[sp - 1];
+	  stack[sp - 1] = stack[sp - 2];
+	  stack[sp - 2] = val;
+	  break;
+
+	case OP_PICK:
+	  // Push a copy of the item n below the top. 0 is the same as dup.
+	  if (!operand (pc, 1, val) || (sp < val + 1) || (sp >= STACK_MAX))
+	    return  false;
+
+	  stack[sp] = stack[sp - 1 - val];
+	  sp++;
+	  pc++;
+	  break;
+
+	case OP_ROT:
+	  // a b c => c a b
+	  if (sp < 3)
+	    return  false;
+
+	  val           = stack[sp - 1];
+	  stack[sp - 1] = stack[sp - 2];
+	  stack[sp - 2] = stack[sp - 3];
+	  stack[sp - 3] = val;
+	  break;
+
+	case OP_PRINTF:
+	  {
+	    // The operands are the number of arguments, then the length of
+	    // the format string, including its NUL, and the string. Above the
+	    // arguments are the function and channel, which we ignore, and
+	    // the first argument is topmost.
+	    uint64_t  nargs;
+	    uint64_t  slen;
+	    uint64_t  args[STACK_MAX];
+
+	    if ((nullptr == out) || !operand (pc, 1, nargs)
+		|| !operand (pc + 1, 2, slen) || (0 == slen)
+		|| (pc + 3 + slen > mBytes.size ())
+		|| (0 != mBytes[pc + 3 + slen - 1]) || (sp < nargs + 2))
+	      return  false;
+
+	    sp -= 2;
+
+	    for (uint64_t  i = 0; i < nargs; i++)
+	      args[i] = stack[--sp];
+
+	    if (!format (cpu, reinterpret_cast<const char *> (&mBytes[pc + 3]),
+			 args, nargs, *out))
+	      return  false;
+
+	    pc += 3 + slen;
+	    break;
+	  }
+
+	default:
+	  // Floating point, tracing, trace state variables or unknown.
+	  return  false;
+	}
+    }
+
+  return  false;			// Ran for too long
+
+}	// eval ()
+
+
+//! Read an operand of an opcode
+
+//! Operands are big-endian.
+
+//! @param[in]  pc   The offset of the operand.
+//! @param[in]  n    The number of bytes in the operand.
+//! @param[out] val  The value of the operand.
+//! @return  TRUE if the operand is within the bytecode, FALSE otherwise.
+
+bool
+AgentExpr::operand (std::size_t  pc,
+		    int          n,
+		    uint64_t    &val) const
+{
+  if (pc + n > mBytes.size ())
+    return  false;
+
+  val = 0;
+
+  for (int  i = 0; i < n; i++)
+    val = (val << 8) | mBytes[pc + i];
+
+  return  true;
+
+}	// operand ()
+
+
+//! Format the output of printf
+
+//! Flags, width and precision are as for the C library. The length
+//! modifiers give the size of the argument on the target, so "l" is the
+//! size of a register. %p and %s take target addresses, and %s reads the
+//! string from target memory. There is no floating point, and no "*" for
+//! width or precision, since GDB does not send them.
+
+//! @param[in]     cpu    The target, to read strings from.
+//! @param[in]     fmt    The format string.
+//! @param[in]     args   The arguments.
+//! @param[in]     nargs  The number of arguments.
+//! @param[in,out] out    The output is appended here.
+//! @return  TRUE if the output was formatted, FALSE if the format was bad,
+//!          there were too few arguments or a string could not be read.
+
+bool
+AgentExpr::format (const ITarget   *cpu,
+		   const char      *fmt,
+		   const uint64_t  *args,
+		   std::size_t      nargs,
+		   std::string     &out)
+{
+  std::size_t  argNum = 0;
+
+  for (const char *p = fmt; '\0' != *p; )
+    {
+      if ('%' != *p)
+	{
+	  out += *p++;
+	  continue;
+	}
+
+      if ('%' == p[1])
+	{
+	  out += '%';
+	  p += 2;
+	  continue;
+	}
+
+      // Keep the flags, width and precision for snprintf.
+      const char   *start = p++;
+      std::size_t   maxLen = STRING_MAX;
+
+      p += strspn (p, "#0- +'");
+      p += strspn (p, "0123456789");
+
+      if ('.' == *p)
+	{
+	  unsigned long  prec = strtoul (p + 1, nullptr, 10);
+
+	  maxLen = (prec < maxLen) ? prec : maxLen;
+	  p++;
+	  p += strspn (p, "0123456789");
+	}
+
+      std::string  spec (start, p - start);
+      int          bits = 32;
+
+      if (('h' == p[0]) && ('h' == p[1]))
+	{
+	  bits = 8;
+	  p += 2;
+	}
+      else if (('l' == p[0]) && ('l' == p[1]))
+	{
+	  bits = 64;
+	  p += 2;
+	}
+      else if ('h' == *p)
+	{
+	  bits = 16;
+	  p++;
+	}
+      else if ('j' == *p)
+	{
+	  bits = 64;
+	  p++;
+	}
+      else if (('l' == *p) || ('z' == *p) || ('t' == *p))
+	{
+	  bits = sizeof (uint_reg_t) * 8;
+	  p++;
+	}
+
+      if (argNum >= nargs)
+	return  false;
+
+      uint64_t     val  = args[argNum++];
+      uint64_t     mask = ~(uint64_t) 0;
+      char         conv = *p++;
+      std::string  str;
+      int          len;
+
+      if (bits < 64)
+	mask = ((uint64_t) 1 << bits) - 1;
+
+      switch (conv)
+	{
+	case 'd':
+	case 'i':
+	  {
+	    // Sign extend from the size of the argument.
+	    uint64_t  sign = (uint64_t) 1 << (bits - 1);
+
+	    val = ((val & mask) ^ sign) - sign;
+	    spec += "lld";
+	    len = snprintf (nullptr, 0, spec.c_str (), (long long) val);
+	    break;
+	  }
+
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+	  val &= mask;
+	  spec += "ll";
+	  spec += conv;
+	  len = snprintf (nullptr, 0, spec.c_str (), (unsigned long long) val);
+	  break;
+
+	case 'c':
+	  val &= 0xff;
+	  spec += 'c';
+	  len = snprintf (nullptr, 0, spec.c_str (), (int) val);
+	  break;
+
+	case 'p':
+	  val &= (uint_reg_t) -1;
+	  spec = "0x" + spec + "llx";
+	  len = snprintf (nullptr, 0, spec.c_str (), (unsigned long long) val);
+	  break;
+
+	case 's':
+	  // Read in aligned chunks, so we never read past the end of memory
+	  // unless the string does.
+	  for (uint32_t  addr = (uint32_t) val; str.size () < maxLen; )
+	    {
+	      uint8_t      buf[64];
+	      std::size_t  n = sizeof (buf) - (addr % sizeof (buf));
+
+	      n = (n < maxLen - str.size ()) ? n : maxLen - str.size ();
+
+	      if (n != cpu->read (addr, buf, n))
+		return  false;
+
+	      uint8_t *nul = static_cast<uint8_t *> (memchr (buf, 0, n));
+
+	      if (nullptr != nul)
+		{
+		  str.append (reinterpret_cast<char *> (buf), nul - buf);
+		  break;
+		}
+
+	      str.append (reinterpret_cast<char *> (buf), n);
+	      addr += n;
+	    }
+
+	  spec += 's';
+	  len = snprintf (nullptr, 0, spec.c_str (), str.c_str ());
+	  break;
+
+	default:
+	  return  false;
+	}
+
+      if ((len < 0) || (len > CONV_MAX))
+	return  false;
+
+      // snprintf writes the NUL, so make room for it and then drop it.
+      std::size_t  old = out.size ();
+
+      out.resize (old + len + 1);
+
+      switch (conv)
+	{
+	case 'd':
+	case 'i':
+	  snprintf (&out[old], len + 1, spec.c_str (), (long long) val);
+	  break;
+
+	case 'c':
+	  snprintf (&out[old], len + 1, spec.c_str (), (int) val);
+	  break;
+
+	case 's':
+	  snprintf (&out[old], len + 1, spec.c_str (), str.c_str ());
+	  break;
+
+	default:
+	  snprintf (&out[old], len + 1, spec.c_str (),
+		    (unsigned long long) val);
+	  break;
+	}
+
+      out.resize (old + len);
+    }
+
+  return  true;
+
+}	// format ()
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
@@ -0,0 +1,143 @@
+// GDB agent expression interpreter: declaration
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef AGENT_EXPR_H
+#define AGENT_EXPR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ITarget;
+
+
+//! A GDB agent expression
+
+//! The bytecode GDB sends with a breakpoint condition, as described in the
+//! "Agent Expressions" appendix of the GDB manual. It is evaluated on a
+//! stack of 64-bit values, reading registers and memory from the target.
+
+//! Only the operations needed to evaluate an expression, and printf for the
+//! commands of a dprintf, are supported. Anything for tracepoints, trace
+//! state variables or floating point is an error.
+
+class AgentExpr
+{
+public:
+
+  // Constructor and destructor
+
+  AgentExpr ();
+  ~AgentExpr ();
+
+  // Read the expression from a packet, and evaluate it
+
+  bool  parse (const char * &str);
+  bool  eval (const ITarget *cpu,
+	      uint64_t      &result,
+	      std::string   *out = nullptr) const;
+
+private:
+
+  //! The opcodes we know about. These have explicit values matching the
+  //! bytecode.
+
+  enum Op
+  {
+    OP_ADD           = 0x02,
+    OP_SUB           = 0x03,
+    OP_MUL           = 0x04,
+    OP_DIV_SIGNED    = 0x05,
+    OP_DIV_UNSIGNED  = 0x06,
+    OP_REM_SIGNED    = 0x07,
+    OP_REM_UNSIGNED  = 0x08,
+    OP_LSH           = 0x09,
+    OP_RSH_SIGNED    = 0x0a,
+    OP_RSH_UNSIGNED  = 0x0b,
+    OP_LOG_NOT       = 0x0e,
+    OP_BIT_AND       = 0x0f,
+    OP_BIT_OR        = 0x10,
+    OP_BIT_XOR       = 0x11,
+    OP_BIT_NOT       = 0x12,
+    OP_EQUAL         = 0x13,
+    OP_LESS_SIGNED   = 0x14,
+    OP_LESS_UNSIGNED = 0x15,
+    OP_EXT           = 0x16,
+    OP_REF8          = 0x17,
+    OP_REF16         = 0x18,
+    OP_REF32         = 0x19,
+    OP_REF64         = 0x1a,
+    OP_IF_GOTO       = 0x20,
+    OP_GOTO          = 0x21,
+    OP_CONST8        = 0x22,
+    OP_CONST16       = 0x23,
+    OP_CONST32       = 0x24,
+    OP_CONST64       = 0x25,
+    OP_REG           = 0x26,
+    OP_END           = 0x27,
+    OP_DUP           = 0x28,
+    OP_POP           = 0x29,
+    OP_ZERO_EXT      = 0x2a,
+    OP_SWAP          = 0x2b,
+    OP_PICK          = 0x32,
+    OP_ROT           = 0x33,
+    OP_PRINTF        = 0x34
+  };
+
+  //! The deepest the stack may go
+
+  static const std::size_t  STACK_MAX = 100;
+
+  //! Most operations an evaluation may carry out. Stops an expression
+  //! which loops forever from hanging the server.
+
+  static const int  MAX_STEPS = 100000;
+
+  //! Longest string printf will read from the target for %s
+
+  static const std::size_t  STRING_MAX = 4096;
+
+  //! Longest output printf will produce for one conversion
+
+  static const int  CONV_MAX = 0x10000;
+
+  //! The bytecode
+
+  std::vector<uint8_t>  mBytes;
+
+  // Internal helpers
+
+  bool  operand (std::size_t  pc,
+		 int          n,
+		 uint64_t    &val) const;
+  static bool  format (const ITarget   *cpu,
+		       const char      *fmt,
+		       const uint64_t  *args,
+		       std::size_t      nargs,
+		       std::string     &out);
+
+};	// class AgentExpr
+
+#endif	// AGENT_EXPR_H
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
@@ -0,0 +1,248 @@
+// Socket file descriptor RSP connection: implementation
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "FdConnection.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+
+//! Constructor
+
+//! @param[in] _traceFlags  flags controlling tracing
+//! @param[in] _clientFd    the client file descriptor, if already connected
+FdConnection::FdConnection (TraceFlags *_traceFlags,
+			    int         _clientFd) :
+  AbstractConnection (_traceFlags),
+  clientFd (_clientFd)
+{
+
+}	// FdConnection ()
+
+
+//! Destructor
+
+//! Subclasses must close the connection, so the reader thread has stopped
+//! before they go.
+FdConnection::~FdConnection ()
+{
+
+}	// ~FdConnection ()
+
+
+//! Close a client connection if it is open
+
+//! Shutting down the socket makes any read by the reader thread return, so
+//! it can be stopped before we close the file descriptor.
+void
+FdConnection::rspClose ()
+{
+  if (isConnected ())
+    {
+      if (! traceFlags->traceSilent ())
+	cout << "Closing connection" << endl;
+
+      shutdown (clientFd, SHUT_RDWR);
+      stopReader ();
+      close (clientFd);
+      clientFd = -1;
+    }
+}	// rspClose ()
+
+
+//! Report if we are connected to a client.
+
+//! @return  TRUE if we are connected, FALSE otherwise
+bool
+FdConnection::isConnected ()
+{
+  return -1 != clientFd;
+
+}	// isConnected ()
+
+//! Put a single character out on the RSP connection
+
+//! Utility routine. This should only be called if the client is open, but we
+//! check for safety.
+
+//! @param[in] c         The character to put out
+
+//! @return  TRUE if char sent OK, FALSE if not (communications failure)
+
+bool
+FdConnection::putRspCharRaw (char  c)
+{
+  if (-1 == clientFd)
+    {
+      cerr << "Warning: Attempt to write '" << c
+		<< "' to unopened RSP client: Ignored" << endl;
+      return  false;
+    }
+
+  // Write until successful (we retry after interrupts) or catastrophic
+  // failure.
+  while (true)
+    {
+      switch (write (clientFd, &c, sizeof (c)))
+	{
+	case -1:
+	  // Error: only allow interrupts or would block
+	  if ((EAGAIN != errno) && (EINTR != errno))
+	    {
+	      cerr << "Warning: Failed to write to RSP client: "
+			<< "Closing client connection: "
+			<<  strerror (errno) << endl;
+	      return  false;
+	    }
+
+	  break;
+
+	case 0:
+	  break;		// Nothing written! Try again
+
+	default:
+	  return  true;		// Success, we can return
+	}
+    }
+}	// putRspCharRaw ()
+
+
+//! Put a block of characters out on the RSP connection
+
+//! Utility routine. This should only be called if the client is open, but we
+//! check for safety. We keep writing until the whole block has gone, since a
+//! write may only take part of it.
+
+//! @param[in] buf  The characters to put out
+//! @param[in] len  The number of characters to put out
+
+//! @return  TRUE if all chars sent OK, FALSE if not (communications failure)
+
+bool
+FdConnection::putRspBlockRaw (const char *buf,
+			      int         len)
+{
+  if (-1 == clientFd)
+    {
+      cerr << "Warning: Attempt to write " << len
+	   << " chars to unopened RSP client: Ignored" << endl;
+      return  false;
+    }
+
+  // Write until everything is sent (we retry after interrupts) or
+  // catastrophic failure.
+  while (len > 0)
+    {
+      ssize_t  count = write (clientFd, buf, len);
+
+      switch (count)
+	{
+	case -1:
+	  // Error: only allow interrupts or would block
+	  if ((EAGAIN != errno) && (EINTR != errno))
+	    {
+	      cerr << "Warning: Failed to write to RSP client: "
+			<< "Closing client connection: "
+			<<  strerror (errno) << endl;
+	      return  false;
+	    }
+
+	  break;
+
+	default:
+	  buf += count;		// Partial success, carry on
+	  len -= count;
+	  break;
+	}
+    }
+
+  return  true;
+
+}	// putRspBlockRaw ()
+
+
+//! Get a block of characters from the RSP connection
+
+//! Utility routine, only called from the reader thread. This should only be
+//! called if the client is open, but we check for safety.
+
+//! A single blocking read gets as many characters as are available, up to
+//! the size of the buffer.
+
+//! @param[out] buf     Buffer for the characters received.
+//! @param[in]  maxLen  Size of the buffer.
+//! @return  The number of characters received, or -1 on failure or when the
+//!          connection is closed.
+
+int
+FdConnection::getRspBlockRaw (char *buf,
+			      int   maxLen)
+{
+  if (-1 == clientFd)
+    {
+      cerr << "Warning: Attempt to read from "
+  	   << "unopened RSP client: Ignored" << endl;
+      return  -1;
+    }
+
+  // Read until successful (we retry after interrupts) or catastrophic
+  // failure.
+
+  for (;;)
+    {
+      ssize_t  count = recv (clientFd, buf, maxLen, 0);
+
+      switch (count)
+  	{
+  	case -1:
+  	  // Error: only allow interrupts
+
+  	  if (EINTR != errno)
+  	    {
+  	      cerr << "Warning: Failed to read from RSP client: "
+  		   << "Closing client connection: "
+  		   <<  strerror (errno) << endl;
+  	      return  -1;
+  	    }
+  	  break;
+
+  	case 0:
+  	  return  -1;
+
+  	default:
+  	  return  count;	// Success, we can return
+  	}
+    }
+}	// getRspBlockRaw ()
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
@@ -0,0 +1,72 @@
+// Socket file descriptor RSP connection: declaration
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FD_CONNECTION_H
+#define FD_CONNECTION_H
+
+#include "AbstractConnection.h"
+#include "TraceFlags.h"
+
+//! Class implementing the RSP connection over a connected socket
+
+//! This does the I/O on the client socket, however it was connected.
+//! Subclasses say how to get a client: RspConnection over TCP and
+//! UnixConnection over a Unix domain socket.
+
+class FdConnection : public AbstractConnection
+{
+public:
+
+  // Constructor and destructor
+
+  FdConnection (TraceFlags *_traceFlags,
+		int         _clientFd = -1);
+  virtual ~FdConnection ();
+
+  // Public interface: manage client connections
+
+  void  rspClose ();
+  bool  isConnected ();
+
+protected:
+
+  //! The client file descriptor, or -1 if there is no client
+
+  int  clientFd;
+
+private:
+
+  // Implementation specific routines to handle individual chars and blocks
+  // of chars.
+
+  virtual bool  putRspCharRaw (char  c);
+  virtual bool  putRspBlockRaw (const char *buf,
+				int         len);
+  virtual int   getRspBlockRaw (char *buf,
+				int   maxLen);
+
+};	// FdConnection ()
+
+#endif	// FD_CONNECTION_H
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
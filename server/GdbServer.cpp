@@ -80,6 +80,37 @@ GdbServer::command (const std::string  cmd,
 }	// GdbServer::rspServer ()
 
 
+//! Get the flag which is set when GDB sends a break (ctrl-C)
+
+//! A target can poll this during a long run, so it stops promptly. The
+//! target must only read the flag.
+
+//! @return  A pointer to the break flag.
+
+const std::atomic<bool> *
+GdbServer::breakFlag () const
+{
+  return  mServerImpl->breakFlag ();
+
+}	// GdbServer::breakFlag ()
+
+
+//! Treat a region of memory as flash
+
+//! @see GdbServerImpl::flashRegion ()
+
+//! @param[in] start   The first address in the region.
+//! @param[in] length  The size of the region in bytes.
+
+void
+GdbServer::flashRegion (uint32_t  start,
+			uint32_t  length)
+{
+  mServerImpl->flashRegion (start, length);
+
+}	// GdbServer::flashRegion ()
+
+
 //! Output operator for KillBehavior enumeration
 
 //! @param[in] s  The stream to output to.
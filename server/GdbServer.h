@@ -26,6 +26,8 @@
 
 // Headers
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 
 // Classes needed for the declaration
@@ -73,6 +75,15 @@ public:
   bool command (const std::string  cmd,
 		std::ostream & stream);
 
+  // Flag set when GDB sends a break, for the target to poll
+
+  const std::atomic<bool> * breakFlag () const;
+
+  // Treat a region of memory as flash, for loading with vFlash packets
+
+  void flashRegion (uint32_t  start,
+		    uint32_t  length);
+
 
 private:
 
@@ -52,19 +52,11 @@ using std::string;
 using std::stringstream;
 using std::vector;
 
-//! This is the length of time we spend running before leaving the model
-//! to check for an interrupt from GDB.  This must always be less than one
-//! second, as that is the smallest timeout a user can set (using the
-//! monitor command) and if this timeout is greater than the user timeout
-//! then things will stop working.  But you want this pretty short anyway
-//! in order that GDB appear responsive.
-const std::chrono::duration <double> GdbServerImpl::interruptTimeout
-                                = std::chrono::duration <double> (0.1);
-
 //! Constructor for the GDB RSP server.
 
 //! Allocate a packet data structure and a new RSP connection. By default no
-//! timeout for run/continue.
+//! timeout for run/continue. The memory map comes from the target, if it
+//! knows its memory layout.
 
 //! @param[in] rspPort      RSP port to use.
 //! @param[in] _cpu         The simulated CPU
@@ -80,10 +72,16 @@ GdbServerImpl::GdbServerImpl (AbstractConnection * _conn,
   mTimeout (duration <double>::zero ()),
   killBehaviour (_killBehaviour),
   mExitServer (false),
+  mNonStop (false),
+  mRunning (false),
   mSyscallContinuation (SYSCALL_NONE_PENDING)
 {
-  pkt           = new RspPacket (RSP_PKT_SIZE);
+  pkt           = new RspPacket (RSP_PKT_SIZE + 1);
   mpHash        = new MpHash ();
+  mPktStats     = new PacketStats ();
+
+  if (!cpu->memoryMap (mMemoryMap))
+    mMemoryMap.clear ();
 
 }	// GdbServerImpl ()
 
@@ -92,6 +90,13 @@ GdbServerImpl::GdbServerImpl (AbstractConnection * _conn,
 
 GdbServerImpl::~GdbServerImpl ()
 {
+  if (traceFlags->traceStats ())
+    {
+      cout << "RSP packet statistics:" << endl;
+      mPktStats->report (cout);
+    }
+
+  delete  mPktStats;
   delete  mpHash;
   delete  pkt;
 
@@ -111,6 +116,11 @@ GdbServerImpl::rspServer ()
       // Make sure we are still connected.
       while (!rsp->isConnected ())
 	{
+	  // Some connections only ever serve one client, in which case we are
+	  // done.
+	  if (!rsp->canReconnect ())
+	    return EXIT_SUCCESS;
+
 	  // Reconnect and stall the processor on a new connection
 	  if (!rsp->rspConnect ())
 	    {
@@ -122,6 +132,29 @@ GdbServerImpl::rspServer ()
 	  // Reset this after making a new connection as the last exit
 	  // will have left it set.
 	  mSyscallContinuation = SYSCALL_NONE_PENDING;
+
+	  // A new client starts off using acknowledgements, in all-stop
+	  // mode, with the target stopped, no breakpoints and nothing
+	  // staged for flash.
+	  rsp->setNoAckMode (false);
+	  mNonStop = false;
+
+	  if (mRunning)
+	    {
+	      (void) cpu->resume (ITarget::ResumeType::STOP);
+	      mRunning = false;
+	    }
+
+	  rspRemoveAllBreakpoints ();
+	  mFlashStage.clear ();
+	}
+
+      // In non-stop mode, run the target a slice at a time while it is
+      // running, dealing with any packets from GDB in between.
+      if (mRunning && !rsp->havePkt ())
+	{
+	  rspRunSlice ();
+	  continue;
 	}
 
       // Get a RSP client request
@@ -150,6 +183,68 @@ GdbServerImpl::command (const std::string  cmd __attribute__ ((unused)),
 }	// GdbServerImpl::rspServer ()
 
 
+//! Get the flag which is set when GDB sends a break (ctrl-C)
+
+//! @return  A pointer to the break flag of our connection.
+
+const std::atomic<bool> *
+GdbServerImpl::breakFlag () const
+{
+  return  rsp->breakFlag ();
+
+}	// GdbServerImpl::breakFlag ()
+
+
+//! Treat a region of memory as flash
+
+//! Our targets only have RAM. But if GDB is told part of it is flash, it
+//! will load programs there with vFlashWrite packets, which we stage and
+//! write to the target in one go at vFlashDone, rather than with a round
+//! trip for each X packet. The region is laid over the target's own memory
+//! map. If the target has none, the rest of memory is described as RAM.
+
+//! GDB will not write to flash other than when loading, so the region
+//! should only hold code and read only data.
+
+//! @param[in] start   The first address in the region.
+//! @param[in] length  The size of the region in bytes.
+
+void
+GdbServerImpl::flashRegion (uint32_t  start,
+			    uint32_t  length)
+{
+  if (mMemoryMap.empty ())
+    mMemoryMap.add (MemoryMap::Type::RAM, 0, (uint64_t) 1 << 32);
+
+  mMemoryMap.overlay (MemoryMap::Type::FLASH, start, length,
+		      FLASH_BLOCK_SIZE);
+
+}	// GdbServerImpl::flashRegion ()
+
+
+//! How much of a range of memory is worth asking the target for
+
+//! Anything outside the memory map is not there, so we can fail straight
+//! away, rather than have the target try each byte. If there is no memory
+//! map, we have to assume all memory is there.
+
+//! @param[in] addr  The first address in the range.
+//! @param[in] len   The size of the range in bytes.
+//! @return  The number of bytes from the start of the range which are in
+//!          memory.
+
+std::size_t
+GdbServerImpl::validLength (uint32_t     addr,
+			    std::size_t  len) const
+{
+  if (mMemoryMap.empty ())
+    return  len;
+
+  return  mMemoryMap.extent (addr, len);
+
+}	// GdbServerImpl::validLength ()
+
+
 //! Some F request packets want to know the length of the string
 //! argument, so we have this simple function here to calculate that.
 
@@ -175,6 +270,19 @@ GdbServerImpl::stringLength (uint32_t addr)
 void
 GdbServerImpl::rspSyscallRequest (SyscallContinuationType cType)
 {
+  // GDB does not accept a File-I/O request as a notification, so there is
+  // no host I/O in non-stop mode.
+  if (mRunning)
+    {
+      cerr << "Warning: Host I/O is not supported in non-stop mode: "
+	   << "reported as a trap" << endl;
+      rspReportException (TargetSignal::TRAP);
+      return;
+    }
+
+  // Any dprintf output comes before the request.
+  rspFlushDprintf (true);
+
   // Keep track of whether we were in the middle of a Continue or Step
   if (mSyscallContinuation != SYSCALL_NONE_PENDING)
     cerr << "Warning: There's already a syscall pending, first one lost?"
@@ -189,38 +297,42 @@ GdbServerImpl::rspSyscallRequest (SyscallContinuationType cType)
   cpu->readRegister (13, a3);
   cpu->readRegister (17, a7);
 
-  // Work out which syscall we've got
+  // Work out which syscall we've got. The packet buffer is always big
+  // enough for any of these, but we bound the writes regardless.
+  char   *buf  = pkt->data;
+  size_t  size = pkt->getBufSize ();
+
   switch (a7) {
-    case 57   : sprintf (pkt->data, "Fclose,%" PRIxREG, a0);
+    case 57   : snprintf (buf, size, "Fclose,%" PRIxREG, a0);
                 break;
-    case 62   : sprintf (pkt->data, "Flseek,%" PRIxREG
-                         ",%" PRIxREG ",%" PRIxREG, a0, a1, a2);
+    case 62   : snprintf (buf, size, "Flseek,%" PRIxREG
+                          ",%" PRIxREG ",%" PRIxREG, a0, a1, a2);
                 break;
-    case 63   : sprintf (pkt->data, "Fread,%" PRIxREG
-                         ",%" PRIxREG ",%" PRIxREG, a0, a1, a2);
+    case 63   : snprintf (buf, size, "Fread,%" PRIxREG
+                          ",%" PRIxREG ",%" PRIxREG, a0, a1, a2);
                 break;
-    case 64   : sprintf (pkt->data, "Fwrite,%" PRIxREG
-                         ",%" PRIxREG ",%" PRIxREG, a0, a1, a2);
+    case 64   : snprintf (buf, size, "Fwrite,%" PRIxREG
+                          ",%" PRIxREG ",%" PRIxREG, a0, a1, a2);
                 break;
-    case 80   : sprintf (pkt->data, "Ffstat,%" PRIxREG ",%" PRIxREG,
-                         a0, a1);
+    case 80   : snprintf (buf, size, "Ffstat,%" PRIxREG ",%" PRIxREG,
+                          a0, a1);
                 break;
-    case 93   : sprintf (pkt->data, "W%" PRIxREG, a0);
+    case 93   : snprintf (buf, size, "W%" PRIxREG, a0);
                 /* We never get a reply from an exit syscall, so don't
                    store a continuation state.  */
                 mSyscallContinuation = SYSCALL_NONE_PENDING;
                 break;
-    case 169  : sprintf (pkt->data, "Fgettimeofday,%" PRIxREG
-                         ",%" PRIxREG, a0, a1);
+    case 169  : snprintf (buf, size, "Fgettimeofday,%" PRIxREG
+                          ",%" PRIxREG, a0, a1);
                 break;
-    case 1024 : sprintf (pkt->data, "Fopen,%" PRIxREG "/%x,%" PRIxREG
-                         ",%" PRIxREG, a0, stringLength (a0), a1, a2);
+    case 1024 : snprintf (buf, size, "Fopen,%" PRIxREG "/%x,%" PRIxREG
+                          ",%" PRIxREG, a0, stringLength (a0), a1, a2);
                 break;
-    case 1026 : sprintf (pkt->data, "Funlink,%" PRIxREG "/%x",
-                         a0, stringLength (a0));
+    case 1026 : snprintf (buf, size, "Funlink,%" PRIxREG "/%x",
+                          a0, stringLength (a0));
                 break;
-    case 1038 : sprintf (pkt->data, "Fstat,%" PRIxREG "/%x,%"
-                         PRIxREG, a0, stringLength (a0), a1);
+    case 1038 : snprintf (buf, size, "Fstat,%" PRIxREG "/%x,%"
+                          PRIxREG, a0, stringLength (a0), a1);
                 break;
     default   : rspReportException (TargetSignal::TRAP);
                 return;
@@ -298,12 +410,15 @@ GdbServerImpl::rspSyscallReply ()
 void
 GdbServerImpl::rspContinue ()
 {
-  // We have two timeouts to worry about.  The first is any timeout set by
-  // the user (through "monitor timeout", the second is a timeout for
-  // checking for crtl-C.
+  // The timeouts are any set by the user (through "monitor timeout"), and
+  // while dprintf output is waiting to be sent. Ctrl-C is spotted by the
+  // connection's reader thread, and the target polls the break flag,
+  // returning TIMEOUT if it is set.
   time_point <system_clock, duration <double> >  timeout_end =
     system_clock::now () + mTimeout;
 
+  rspCommitBreakpoints ();
+
   // Check for break before resuming the machine.
   if (rsp->haveBreak ())
     {
@@ -314,9 +429,25 @@ GdbServerImpl::rspContinue ()
 
   for (;;)
     {
+      // While dprintf output is waiting, come back in time to send it.
+      duration <double>  runTime = mTimeout;
+
+      if (!mDprintfBuf.empty ())
+        {
+          duration <double>  left =
+            mDprintfStart + duration <double> (DPRINTF_FLUSH_MS * 0.001)
+            - system_clock::now ();
+
+          // A zero timeout would mean none at all.
+          if (left <= duration <double>::zero ())
+            left = duration <double> (0.001);
+
+          if ((duration <double>::zero () == runTime) || (left < runTime))
+            runTime = left;
+        }
+
       ITarget::ResumeRes resType =
-        cpu->resume (ITarget::ResumeType::CONTINUE,
-                     interruptTimeout);
+        cpu->resume (ITarget::ResumeType::CONTINUE, runTime);
 
       switch (resType)
         {
@@ -331,7 +462,10 @@ GdbServerImpl::rspContinue ()
         case ITarget::ResumeRes::STEPPED:
         case ITarget::ResumeRes::INTERRUPTED:
 
-          // At breakpoint
+          // At breakpoint, unless its condition is false
+          if (!rspBreakpointHit ())
+            break;
+
           rspReportException (TargetSignal::TRAP);
           return;
 
@@ -357,6 +491,8 @@ GdbServerImpl::rspContinue ()
               return;
             }
 
+          // Send any dprintf output which has waited long enough.
+          rspFlushDprintf (false);
           break;
 
         default:
@@ -374,6 +510,8 @@ GdbServerImpl::rspContinue ()
 void
 GdbServerImpl::rspSingleStep ()
 {
+  rspCommitBreakpoints ();
+
   // Check for break before resuming the machine.
   if (rsp->haveBreak ())
     {
@@ -402,16 +540,225 @@ GdbServerImpl::rspSingleStep ()
   return;
 }
 
-//! Deal with a request from the GDB client session
 
-//! In general, apart from the simplest requests, this function replies on
-//! other functions to implement the functionality.
+//! Single step while the PC is in a range
 
-//! @note It is the responsibility of the recipient to delete the packet when
-//!       it is finished with. It is permissible to reuse the packet for a
-//!       reply.
+//! This is the range stepping of vCont, which GDB uses to step over a
+//! source line. Rather than a round trip to GDB for every instruction, we
+//! keep stepping until the PC leaves the range, and only then report.
+
+//! We also stop for anything other than a plain step (such as hitting a
+//! breakpoint instruction), at a breakpoint GDB has inserted, if GDB
+//! sends a break or if the timeout set by the user expires.
+
+//! @param[in] start  The first address in the range.
+//! @param[in] end    The first address after the range.
+
+void
+GdbServerImpl::rspRangeStep (uint32_t  start,
+			     uint32_t  end)
+{
+  time_point <system_clock, duration <double> >  timeout_end =
+    system_clock::now () + mTimeout;
+
+  rspCommitBreakpoints ();
+
+  // Check for break before resuming the machine.
+  if (rsp->haveBreak ())
+    {
+      (void) cpu->resume (ITarget::ResumeType::STOP);
+      rspReportException (TargetSignal::INT);
+      return;
+    }
+
+  for (;;)
+    {
+      ITarget::ResumeRes resType = cpu->resume (ITarget::ResumeType::STEP);
+
+      if (resType == ITarget::ResumeRes::SYSCALL)
+	{
+	  rspSyscallRequest (SYSCALL_THEN_FINISH_STEPPING);
+	  return;
+	}
+
+      // Check for break now we've stopped.
+      if (rsp->haveBreak ())
+	{
+	  (void) cpu->resume (ITarget::ResumeType::STOP);
+	  rspReportException (TargetSignal::INT);
+	  return;
+	}
+
+      // Carry on past a breakpoint whose condition is false.
+      if ((resType == ITarget::ResumeRes::INTERRUPTED)
+	  && !rspBreakpointHit ())
+	resType = ITarget::ResumeRes::STEPPED;
+
+      if (resType != ITarget::ResumeRes::STEPPED)
+	break;
+
+      // Stop out of the range or at a breakpoint. A breakpoint with a
+      // condition or commands is dealt with here, before its breakpoint
+      // instruction is stepped, since not every target reports stepping
+      // C.EBREAK as a hit. If the target is stepped past it, look again at
+      // where it is now.
+      uint_reg_t  pc;
+      bool        report;
+      bool        steppedPast;
+
+      do
+	{
+	  steppedPast = false;
+	  report      = (0 == cpu->readRegister (RISCV_PC_REGNUM, pc))
+	    || (pc < start) || (pc >= end);
+
+	  if (!report && mpHash->breakAt (pc))
+	    {
+	      if ((0 == mBpConds.count (pc)) && (0 == mBpCmds.count (pc)))
+		report = true;
+	      else
+		{
+		  report      = rspBreakpointHit ();
+		  steppedPast = !report;
+		}
+	    }
+	}
+      while (steppedPast);
+
+      if (report)
+	break;
+
+      if ((duration <double>::zero () != mTimeout)
+	  && (timeout_end < system_clock::now ()))
+	{
+	  rspReportException (TargetSignal::XCPU);	// Timeout
+	  return;
+	}
+    }
+
+  rspReportException (TargetSignal::TRAP);
+
+}	// rspRangeStep ()
+
+
+//! Start a resume in non-stop mode
+
+//! In non-stop mode, acknowledge the vCont request which resumes the
+//! target, and mark the target as running, so its stop is reported with a
+//! notification. In all-stop mode, do nothing.
+
+//! @return  TRUE if we are in non-stop mode, FALSE otherwise.
+
+bool
+GdbServerImpl::rspNonStopResume ()
+{
+  if (!mNonStop)
+    return  false;
+
+  pkt->packStr ("OK");
+  rsp->putPkt (pkt);
+
+  if (!mRunning)
+    {
+      mRunning = true;
+      mRunEnd  = system_clock::now () + mTimeout;
+    }
+
+  return  true;
+
+}	// rspNonStopResume ()
+
+
+//! Stop the target in non-stop mode
+
+//! If the target is running, stop it and report the stop with a
+//! notification. If not, there is nothing to do.
+
+//! @param[in] sig  The signal to report.
+
+void
+GdbServerImpl::rspNonStopStop (TargetSignal  sig)
+{
+  if (!mRunning)
+    return;
+
+  (void) cpu->resume (ITarget::ResumeType::STOP);
+  rspReportException (sig);
+
+}	// rspNonStopStop ()
+
+
+//! Run the target for one slice in non-stop mode
 
-//! @param[in] pkt  The received RSP packet
+//! Called from the server loop while the target is running and there are
+//! no packets from GDB waiting. The target is run with a timeout of
+//! NON_STOP_SLICE_MS, so any packet which arrives meanwhile is dealt with
+//! soon after. The target is stopped between slices, while the packets are
+//! dealt with.
+
+//! If the target stops for any other reason, or the user's timeout runs
+//! out, the stop is reported with a notification.
+
+//! Host I/O is not available in non-stop mode, so a syscall is reported as
+//! a trap (@see rspSyscallRequest ()).
+
+void
+GdbServerImpl::rspRunSlice ()
+{
+  if (rsp->haveBreak ())
+    {
+      rspNonStopStop (TargetSignal::INT);
+      return;
+    }
+
+  // GDB may have changed its breakpoints since the last slice.
+  rspCommitBreakpoints ();
+
+  ITarget::ResumeRes resType =
+    cpu->resume (ITarget::ResumeType::CONTINUE,
+		 duration <double> (NON_STOP_SLICE_MS * 0.001));
+
+  switch (resType)
+    {
+    case ITarget::ResumeRes::SYSCALL:
+
+      rspSyscallRequest (SYSCALL_THEN_FINISH_CONTINUE);
+      return;
+
+    case ITarget::ResumeRes::STEPPED:
+    case ITarget::ResumeRes::INTERRUPTED:
+
+      // At breakpoint, unless its condition is false
+      if (rspBreakpointHit ())
+	rspReportException (TargetSignal::TRAP);
+
+      return;
+
+    case ITarget::ResumeRes::TIMEOUT:
+
+      // End of the slice, unless the user's timeout has run out too.
+      if ((duration <double>::zero () != mTimeout)
+	  && (mRunEnd < system_clock::now ()))
+	rspNonStopStop (TargetSignal::XCPU);
+      else
+	rspFlushDprintf (false);
+
+      return;
+
+    default:
+
+      // Should never occur.  We exit the gdbserver if this happens.
+      cerr << "*** ABORT: Unrecognized continue return from resume: "
+	   << "terminating" << resType << endl;
+      exit (EXIT_FAILURE);
+    }
+}	// rspRunSlice ()
+
+
+//! Deal with a request from the GDB client session
+
+//! Get the packet, dispatch it, and record how long it took for the packet
+//! statistics.
 
 void
 GdbServerImpl::rspClientRequest ()
@@ -422,6 +769,37 @@ GdbServerImpl::rspClientRequest ()
       return;
     }
 
+  // Note what we need for the statistics before the packet is reused for the
+  // reply.
+  string  name     = PacketStats::name (pkt->data, pkt->getLen ());
+  int     bytesIn  = pkt->getLen ();
+  auto    rxTime   = rsp->rxTime ();
+  auto    start    = PacketStats::Clock::now ();
+  auto    txTime   = rsp->txTime ();
+  auto    txBytes  = rsp->txBytes ();
+
+  rspDispatch ();
+
+  auto  ioTime = rsp->txTime () - txTime;
+
+  mPktStats->record (name, bytesIn, rsp->txBytes () - txBytes,
+		     start - rxTime,
+		     PacketStats::Clock::now () - start - ioTime, ioTime);
+
+}	// rspClientRequest ()
+
+
+//! Dispatch a request from the GDB client session
+
+//! In general, apart from the simplest requests, this function replies on
+//! other functions to implement the functionality.
+
+//! @note The request is in pkt. It is permissible to reuse the packet for a
+//!       reply.
+
+void
+GdbServerImpl::rspDispatch ()
+{
   switch (pkt->data[0])
     {
     case '!':
@@ -431,8 +809,16 @@ GdbServerImpl::rspClientRequest ()
       return;
 
     case '?':
-      // Return last signal ID
-      rspReportException ();
+      // Return last signal ID. In non-stop mode, if the target is running
+      // there is no stop to report.
+      if (mRunning)
+	{
+	  pkt->packStr ("OK");
+	  rsp->putPkt (pkt);
+	}
+      else
+	rspReportException ();
+
       return;
 
     case 'A':
@@ -474,7 +860,11 @@ GdbServerImpl::rspClientRequest ()
 
     case 'D':
       // Detach GDB. Do this by closing the client. The rules say that
-      // execution should continue, so unstall the processor.
+      // execution should continue, so unstall the processor, without any
+      // breakpoints. Anything staged for flash by a load GDB did not finish
+      // is dropped.
+      rspRemoveAllBreakpoints ();
+      mFlashStage.clear ();
       pkt->packStr("OK");
       rsp->putPkt (pkt);
       rsp->rspClose ();
@@ -508,7 +898,11 @@ GdbServerImpl::rspClientRequest ()
       return;
 
     case 'k':
-      // Kill request.
+      // Kill request. GDB forgets its breakpoints, so we do too, along
+      // with anything staged for flash.
+      rspRemoveAllBreakpoints ();
+      mFlashStage.clear ();
+
       switch (killBehaviour)
 	{
 	case GdbServer::KillBehaviour::EXIT_ON_KILL:
@@ -586,6 +980,11 @@ GdbServerImpl::rspClientRequest ()
       rspVpkt ();
       return;
 
+    case 'x':
+      // Read memory (binary)
+      rspReadMemBin ();
+      return;
+
     case 'X':
       // Write memory (binary)
       rspWriteMemBin ();
@@ -606,24 +1005,66 @@ GdbServerImpl::rspClientRequest ()
       cerr << "Warning: Unknown RSP request" << pkt->data << endl;
       return;
     }
-}	// rspClientRequest ()
+}	// rspDispatch ()
 
 
 //! Send a packet acknowledging an exception has occurred
 
+//! This is a T packet, with the registers GDB needs to find where it has
+//! stopped and the current frame, and our thread id. That saves GDB asking
+//! for them with g or p packets after every stop, each of which means
+//! reading registers through the target's debug unit.
+
+//!   T<sig><regnum>:<value>;...;thread:<tid>;
+
+//! In non-stop mode, if the target was running, this is sent as a Stop
+//! notification.
+
 //! @param[in] sig  The signal to send (defaults to TargetSignal::TRAP).
 
 void
 GdbServerImpl::rspReportException (TargetSignal  sig)
 {
+  static const int  expedited[] = {
+    RISCV_PC_REGNUM, RISCV_SP_REGNUM, RISCV_RA_REGNUM, RISCV_FP_REGNUM
+  };
+
+  // Any dprintf output comes before the stop.
+  rspFlushDprintf (true);
+
   // Construct a signal received packet
-  pkt->data[0] = 'S';
-  pkt->data[1] = Utils::hex2Char (static_cast<int> (sig) >> 4);
-  pkt->data[2] = Utils::hex2Char (static_cast<int> (sig) % 16);
-  pkt->data[3] = '\0';
+  char *p = pkt->data;
+
+  *p++ = 'T';
+  *p++ = Utils::hex2Char (static_cast<int> (sig) >> 4);
+  *p++ = Utils::hex2Char (static_cast<int> (sig) % 16);
+
+  for (int  regNum : expedited)
+    {
+      uint_reg_t   val;
+      std::size_t  byteSize = cpu->readRegister (regNum, val);
+
+      if (0 == byteSize)
+	continue;			// GDB can ask for it if it wants it
+
+      p += sprintf (p, "%02x:", regNum);
+      Utils::val2Hex (val, p, byteSize, true /* little endian */);
+      p += byteSize * 2;
+      *p++ = ';';
+    }
+
+  sprintf (p, "thread:%x;", DUMMY_TID);
   pkt->setLen (strlen (pkt->data));
 
-  rsp->putPkt (pkt);
+  // In non-stop mode, the stop of a running target is reported with a
+  // notification, rather than as the reply to a packet.
+  if (mRunning)
+    {
+      mRunning = false;
+      rsp->putNotification ("Stop", pkt);
+    }
+  else
+    rsp->putPkt (pkt);
 
 }	// rspReportException ()
 
@@ -640,6 +1081,9 @@ GdbServerImpl::rspReadAllRegs ()
 {
   int  pktSize = 0;
 
+  // Room for all the registers, and an EOS.
+  pkt->reserve (RISCV_NUM_REG_BYTES * 2 + 1);
+
   // The registers. GDB client expects them to be packed according to target
   // endianness.
   for (int  regNum = 0; regNum < RISCV_NUM_REGS; regNum++)
@@ -716,20 +1160,37 @@ GdbServerImpl::rspReadMem ()
       return;
     }
 
-  // Make sure we won't overflow the buffer (2 chars per byte)
-  if ((len * 2) >= pkt->getBufSize())
+  // Make sure we won't overflow the buffer (2 chars per byte). GDB never
+  // asks for more than fits in the PacketSize we advertised. A short reply
+  // is allowed, and GDB will ask for the rest.
+  if ((len < 0) || (len > RSP_PKT_SIZE / 2))
     {
       cerr << "Warning: Memory read " << pkt->data
 	   << " too large for RSP packet: truncated" << endl;
-      len = (pkt->getBufSize() - 1) / 2;
+      len = RSP_PKT_SIZE / 2;
+    }
+
+  // Fail straight away if none of it is there, and only read what is, in
+  // which case GDB will ask for the rest and get an error.
+  int  valid = validLength (addr, len);
+
+  if ((0 == valid) && (len > 0))
+    {
+      pkt->packStr ("E01");
+      rsp->putPkt (pkt);
+      return;
     }
 
+  len = valid;
+  pkt->reserve (len * 2 + 1);
+
   // Refill the buffer with the reply
   for (off = 0; off < len; off++)
     {
       uint8_t  ch;
       if (1 == cpu->read (addr + off, &ch, 1))
 	{
+	  rspShadowBreakpoints (addr + off, &ch, 1);
 	  pkt->data[off * 2]     = Utils::hex2Char(ch >>   4);
 	  pkt->data[off * 2 + 1] = Utils::hex2Char(ch &  0xf);
 	}
@@ -749,6 +1210,67 @@ GdbServerImpl::rspReadMem ()
 }	// rsp_read_mem ()
 
 
+//! Handle a RSP read memory (binary) request
+
+//! Syntax is:
+
+//!   x<addr>,<length>
+
+//! The reply is 'b' followed by the memory contents as raw binary, which
+//! putPkt () escapes as it frames the packet. So the reply is about half the
+//! size of the reply to 'm'. The memory is fetched with a single read from
+//! the target, straight into the reply.
+
+//! A short reply is allowed, if the whole range could not be read. An error
+//! is only reported if nothing could be read.
+
+void
+GdbServerImpl::rspReadMemBin ()
+{
+  uint32_t  addr;			// Where to read the memory
+  int       len;			// Number of bytes to read
+
+  if (2 != sscanf (pkt->data, "x%x,%x", &addr, &len))
+    {
+      cerr << "Warning: Failed to recognize RSP read memory (binary) "
+	   << "command: " << pkt->data << endl;
+      pkt->packStr ("E01");
+      rsp->putPkt (pkt);
+      return;
+    }
+
+  // Make sure we won't overflow the buffer. In the worst case every byte is
+  // escaped, which is no worse than 'm'.
+  if ((len < 0) || (len > RSP_PKT_SIZE / 2))
+    {
+      cerr << "Warning: Memory read " << pkt->data
+	   << " too large for RSP packet: truncated" << endl;
+      len = RSP_PKT_SIZE / 2;
+    }
+
+  pkt->reserve (len + 2);
+  pkt->data[0] = 'b';
+
+  // Only ask the target for what is in memory.
+  std::size_t  valid = validLength (addr, len);
+  std::size_t  got   = (valid > 0)
+    ? cpu->read (addr, (uint8_t *) (pkt->data + 1), valid) : 0;
+
+  if ((0 == got) && (len > 0))
+    {
+      pkt->packStr ("E01");
+      rsp->putPkt (pkt);
+      return;
+    }
+
+  rspShadowBreakpoints (addr, (uint8_t *) (pkt->data + 1), got);
+  pkt->data[got + 1] = '\0';
+  pkt->setLen (got + 1);
+  rsp->putPkt (pkt);
+
+}	// rspReadMemBin ()
+
+
 //! Handle a RSP write memory (symbolic) request
 
 //! Syntax is:
@@ -776,7 +1298,17 @@ GdbServerImpl::rspWriteMem ()
     }
 
   // Find the start of the data and check there is the amount we expect.
-  char *symDat = (char *)(memchr (pkt->data, ':', pkt->getBufSize())) + 1;
+  char *colon = (char *) memchr (pkt->data, ':', pkt->getLen ());
+
+  if (nullptr == colon)
+    {
+      cerr << "Warning: No data in RSP write memory " << pkt->data << endl;
+      pkt->packStr ("E01");
+      rsp->putPkt (pkt);
+      return;
+    }
+
+  char *symDat = colon + 1;
   int   datLen = pkt->getLen() - (symDat - pkt->data);
 
   // Sanity check
@@ -789,12 +1321,22 @@ GdbServerImpl::rspWriteMem ()
       return;
     }
 
-  // Write the bytes to memory (no check the address is OK here)
-  for (int  off = 0; off < len; off++)
+  // Write nothing unless it is all in memory.
+  if (validLength (addr, len) < (std::size_t) len)
     {
-      uint8_t  nyb1 = Utils::char2Hex (symDat[off * 2]);
-      uint8_t  nyb2 = Utils::char2Hex (symDat[off * 2 + 1]);
-      uint8_t  val = static_cast<unsigned int> ((nyb1 << 4) | nyb2);
+      pkt->packStr ("E01");
+      rsp->putPkt (pkt);
+      return;
+    }
+
+  // Write the bytes to memory
+  rspUnplantBreakpoints (addr, len);
+
+  for (int  off = 0; off < len; off++)
+    {
+      uint8_t  nyb1 = Utils::char2Hex (symDat[off * 2]);
+      uint8_t  nyb2 = Utils::char2Hex (symDat[off * 2 + 1]);
+      uint8_t  val = static_cast<unsigned int> ((nyb1 << 4) | nyb2);
 
       if (1 != cpu->write (addr + off, &val, 1))
 	cerr << "Warning: Failed to write character" << endl;
@@ -909,12 +1451,10 @@ GdbServerImpl::rspQuery ()
       pkt->setLen (strlen (pkt->data));
       rsp->putPkt (pkt);
     }
-  else if (0 == strncmp ("qCRC", pkt->data, strlen ("qCRC")))
+  else if (0 == strncmp ("qCRC:", pkt->data, strlen ("qCRC:")))
     {
       // Return CRC of memory area
-      cerr << "Warning: RSP CRC query not supported" << endl;
-      pkt->packStr ("E01");
-      rsp->putPkt (pkt);
+      rspCrc ();
     }
   else if (0 == strcmp ("qfThreadInfo", pkt->data))
     {
@@ -943,6 +1483,12 @@ GdbServerImpl::rspQuery ()
       // This is used to interface to commands to do "stuff"
       rspCommand ();
     }
+  else if (0 == strncmp ("qSearch:memory:", pkt->data,
+			 strlen ("qSearch:memory:")))
+    {
+      // Search memory for a pattern
+      rspSearchMemory ();
+    }
   else if (0 == strncmp ("qSupported", pkt->data, strlen ("qSupported")))
     {
       // Report a list of the features we support. For now we just ignore any
@@ -950,7 +1496,11 @@ GdbServerImpl::rspQuery ()
       // supported as well. Note that the packet size allows for 'G' + all the
       // registers sent to us, or a reply to 'g' with all the registers and an
       // EOS so the buffer is a well formed string.
-      sprintf (pkt->data, "PacketSize=%x", pkt->getBufSize());
+      snprintf (pkt->data, pkt->getBufSize (),
+		"PacketSize=%x;QStartNoAckMode+;QNonStop+;binary-upload+"
+		";ConditionalBreakpoints+;BreakpointCommands+%s",
+		RSP_PKT_SIZE,
+		mMemoryMap.empty () ? "" : ";qXfer:memory-map:read+");
       pkt->setLen (strlen (pkt->data));
       rsp->putPkt (pkt);
     }
@@ -962,6 +1512,11 @@ GdbServerImpl::rspQuery ()
       pkt->packStr ("OK");
       rsp->putPkt (pkt);
     }
+  else if (0 == strncmp ("qXfer:memory-map:read:", pkt->data,
+			 strlen ("qXfer:memory-map:read:")))
+    {
+      rspMemoryMapRead ();
+    }
   else if (0 == strncmp ("qThreadExtraInfo,", pkt->data,
 			 strlen ("qThreadExtraInfo,")))
     {
@@ -981,6 +1536,162 @@ GdbServerImpl::rspQuery ()
 }	// rspQuery ()
 
 
+//! Handle a RSP CRC request
+
+//! Syntax is:
+
+//!   qCRC:<addr>,<length>
+
+//! The reply is C followed by the CRC-32 of the memory in hex, as computed
+//! by Utils::crc32 (), or E01 if any of it could not be read. GDB uses this
+//! to compare sections, and to verify a load, without reading the memory
+//! back. We read the memory in large blocks, so a large image takes few
+//! calls to the target.
+
+void
+GdbServerImpl::rspCrc ()
+{
+  uint32_t  addr;
+  uint32_t  len;
+
+  if (2 != sscanf (pkt->data, "qCRC:%x,%x", &addr, &len))
+    {
+      cerr << "Warning: Failed to recognize RSP CRC query: " << pkt->data
+	   << endl;
+      pkt->packStr ("E01");
+      rsp->putPkt (pkt);
+      return;
+    }
+
+  if (validLength (addr, len) < len)
+    {
+      pkt->packStr ("E01");
+      rsp->putPkt (pkt);
+      return;
+    }
+
+  vector<uint8_t>  buf (len < MEM_BLOCK_SIZE ? len : MEM_BLOCK_SIZE);
+  uint32_t         crc = 0xffffffff;
+
+  while (len > 0)
+    {
+      std::size_t  n = (len < buf.size ()) ? len : buf.size ();
+
+      if (cpu->read (addr, buf.data (), n) != n)
+	{
+	  pkt->packStr ("E01");
+	  rsp->putPkt (pkt);
+	  return;
+	}
+
+      rspShadowBreakpoints (addr, buf.data (), n);
+      crc   = Utils::crc32 (buf.data (), n, crc);
+      addr += n;
+      len  -= n;
+    }
+
+  sprintf (pkt->data, "C%x", crc);
+  pkt->setLen (strlen (pkt->data));
+  rsp->putPkt (pkt);
+
+}	// rspCrc ()
+
+
+//! Handle a RSP search memory request
+
+//! Syntax is:
+
+//!   qSearch:memory:<addr>;<length>;<pattern>
+
+//! The pattern is binary, and has already been unescaped by the
+//! connection. The reply is 1,<addr> with the address of the first match,
+//! 0 if there is none, or E01 if the memory could not be read.
+
+//! Without this, GDB's find command reads the memory back and searches it
+//! itself. We read the memory in large blocks, each starting with the end
+//! of the last, so a match across blocks is not missed, and search each
+//! with memmem (), which the C library vectorizes.
+
+//! Only memory in the memory map is searched.
+
+void
+GdbServerImpl::rspSearchMemory ()
+{
+  uint32_t  addr;
+  uint32_t  len;
+  char     *end  = pkt->data + pkt->getLen ();
+  char     *semi = (char *) memchr (pkt->data, ';', pkt->getLen ());
+
+  if (nullptr != semi)
+    semi = (char *) memchr (semi + 1, ';', end - semi - 1);
+
+  if ((nullptr == semi) || (semi + 1 == end)
+      || (2 != sscanf (pkt->data, "qSearch:memory:%x;%x;", &addr, &len)))
+    {
+      cerr << "Warning: Failed to recognize RSP search memory request"
+	   << endl;
+      pkt->packStr ("E01");
+      rsp->putPkt (pkt);
+      return;
+    }
+
+  // The pattern is in the packet buffer, which we need for the reply.
+  vector<uint8_t>  pattern (semi + 1, end);
+  std::size_t      patLen = pattern.size ();
+
+  if (validLength (addr, 1) == 0)
+    {
+      pkt->packStr ("E01");
+      rsp->putPkt (pkt);
+      return;
+    }
+
+  std::size_t      left   = validLength (addr, len);
+  vector<uint8_t>  buf (MEM_BLOCK_SIZE + patLen - 1);
+  uint64_t         bufAddr = addr;	// Address of buf[0]
+  std::size_t      kept    = 0;		// Chars kept from last block
+
+  while (left > 0)
+    {
+      std::size_t  n = left;
+
+      if (n > MEM_BLOCK_SIZE)
+	n = MEM_BLOCK_SIZE;
+
+      if (cpu->read (bufAddr + kept, buf.data () + kept, n) != n)
+	{
+	  pkt->packStr ("E01");
+	  rsp->putPkt (pkt);
+	  return;
+	}
+
+      rspShadowBreakpoints (bufAddr + kept, buf.data () + kept, n);
+
+      std::size_t  have  = kept + n;
+      uint8_t     *match = (uint8_t *) memmem (buf.data (), have,
+					       pattern.data (), patLen);
+
+      if (nullptr != match)
+	{
+	  sprintf (pkt->data, "1,%" PRIx64, bufAddr + (match - buf.data ()));
+	  pkt->setLen (strlen (pkt->data));
+	  rsp->putPkt (pkt);
+	  return;
+	}
+
+      // Keep the end of this block, in case a match starts there.
+      left   -= n;
+      kept    = (have < patLen - 1) ? have : patLen - 1;
+      memmove (buf.data (), buf.data () + have - kept, kept);
+      bufAddr += have - kept;
+    }
+
+  pkt->packStr ("0");
+  rsp->putPkt (pkt);
+
+}	// rspSearchMemory ()
+
+
 //! Handle a RSP qRcmd request
 
 //! The actual command follows the "qRcmd," in ASCII encoded to hex
@@ -1024,6 +1735,12 @@ GdbServerImpl::rspCommand ()
 	"    Show whether RSP tracing is enabled\n",
 	"  echo <message>\n",
 	"    Echo <message> on stdout of the gdbserver\n",
+	"  stats packets\n",
+	"    Report RSP packet counts, sizes and latencies\n",
+	"  set dprintf-log [<file>]\n",
+	"    Append dprintf output to <file>, or send it to GDB if none\n",
+	"  show dprintf-log\n",
+	"    Show where dprintf output goes\n",
 	nullptr };
 
       for (int i = 0; nullptr != mess[i]; i++)
@@ -1151,6 +1868,25 @@ GdbServerImpl::rspCommand ()
 	  ++tmp;
 	cerr << std::flush;
 	cout << tmp << std::endl << std::flush;
+	pkt->packStr ("OK");
+	rsp->putPkt (pkt);
+      }
+    else if (0 == strcmp (cmd, "stats packets"))
+      {
+	stringstream  ss;
+	string        line;
+
+	mPktStats->report (ss);
+
+	while (getline (ss, line, '\n'))
+	  {
+	    line.append ("\n");
+	    pkt->packRcmdStr (line.c_str (), true);
+	    rsp->putPkt (pkt);
+	  }
+
+	// Not silent, so acknowledge OK
+
 	pkt->packStr ("OK");
 	rsp->putPkt (pkt);
       }
@@ -1266,6 +2002,39 @@ GdbServerImpl::rspSetCommand (const char* cmd)
       rsp->putPkt (pkt);
       return;
     }
+  else if (((numTok == 1) || (numTok == 2))
+	   && (string ("dprintf-log") == tokens[0]))
+    {
+      // monitor set dprintf-log [<file>]
+
+      rspFlushDprintf (true);
+
+      if (mDprintfLog.is_open ())
+	mDprintfLog.close ();
+
+      mDprintfLogName.clear ();
+
+      if (numTok == 2)
+	{
+	  mDprintfLog.clear ();
+	  mDprintfLog.open (tokens[1].c_str (), std::ios::out | std::ios::app);
+
+	  if (!mDprintfLog.is_open ())
+	    {
+	      cerr << "Warning: Cannot open dprintf log file " << tokens[1]
+		   << ": dprintf output goes to GDB" << endl;
+	      pkt->packStr ("E01");
+	      rsp->putPkt (pkt);
+	      return;
+	    }
+
+	  mDprintfLogName = tokens[1];
+	}
+
+      pkt->packStr ("OK");
+      rsp->putPkt (pkt);
+      return;
+    }
   else
     {
       // Not handled here, try the target
@@ -1345,6 +2114,20 @@ GdbServerImpl::rspShowCommand (const char* cmd)
       oss << flagName << ": " << (traceFlags->flag (flagName) ? "ON" : "OFF")
 	  << endl;
 
+      pkt->packRcmdStr (oss.str ().c_str (), true);
+      rsp->putPkt (pkt);
+      pkt->packStr ("OK");
+      rsp->putPkt (pkt);
+    }
+  else if ((numTok == 1) && (string ("dprintf-log") == tokens[0]))
+    {
+      // monitor show dprintf-log
+
+      ostringstream  oss;
+
+      oss << "dprintf-log: "
+	  << (mDprintfLogName.empty () ? "GDB" : mDprintfLogName) << endl;
+
       pkt->packRcmdStr (oss.str ().c_str (), true);
       rsp->putPkt (pkt);
       pkt->packStr ("OK");
@@ -1380,257 +2163,556 @@ GdbServerImpl::rspShowCommand (const char* cmd)
 
 //! Handle a RSP set request.
 
-//! There are none that we support, so we always return an empty packet.
+//! The only one we support is QStartNoAckMode. For anything else we return
+//! an empty packet.
 
 void
 GdbServerImpl::rspSet ()
 {
-  pkt->packStr ("");
-  rsp->putPkt (pkt);
+  if (0 == strcmp ("QStartNoAckMode", pkt->data))
+    {
+      // The reply is still acknowledged by the client. Only after that do
+      // we both stop using acknowledgements.
+      pkt->packStr ("OK");
+      rsp->putPkt (pkt);
+      rsp->setNoAckMode (true);
+    }
+  else if ((0 == strcmp ("QNonStop:0", pkt->data))
+	   || (0 == strcmp ("QNonStop:1", pkt->data)))
+    {
+      // Going back to all-stop mode stops the target.
+      mNonStop = ('1' == pkt->data[strlen ("QNonStop:")]);
+
+      if (!mNonStop && mRunning)
+	{
+	  (void) cpu->resume (ITarget::ResumeType::STOP);
+	  mRunning = false;
+	}
 
+      pkt->packStr ("OK");
+      rsp->putPkt (pkt);
+    }
+  else
+    {
+      pkt->packStr ("");
+      rsp->putPkt (pkt);
+    }
 }	// rspSet ()
 
 
 //! Handle a RSP 'v' packet
 
-//! @todo for now we don't handle V packets.
+//! For now we only handle vCont, the non-stop packets vStopped and vCtrlC,
+//! and the flash packets used for loading. Anything else gets an empty
+//! reply.
 
 void
 GdbServerImpl::rspVpkt ()
 {
-  pkt->packStr ("");
-  rsp->putPkt (pkt);
-
+  if (0 == strncmp ("vCont", pkt->data, strlen ("vCont")))
+    rspVCont ();
+  else if (0 == strcmp ("vStopped", pkt->data))
+    {
+      // We only have one thread, so there is never a further stop to report
+      // after the one in the notification.
+      pkt->packStr ("OK");
+      rsp->putPkt (pkt);
+    }
+  else if (0 == strcmp ("vCtrlC", pkt->data))
+    {
+      // Interrupt the target, as ctrl-C does in all-stop mode.
+      pkt->packStr ("OK");
+      rsp->putPkt (pkt);
+      rspNonStopStop (TargetSignal::INT);
+    }
+  else if (0 == strncmp ("vFlashErase:", pkt->data, strlen ("vFlashErase:")))
+    rspFlashErase ();
+  else if (0 == strncmp ("vFlashWrite:", pkt->data, strlen ("vFlashWrite:")))
+    rspFlashWrite ();
+  else if (0 == strcmp ("vFlashDone", pkt->data))
+    rspFlashDone ();
+  else
+    {
+      // We don't support this feature
+      pkt->packStr ("");
+      rsp->putPkt (pkt);
+    }
 }	// rspVpkt ()
 
 
-//! Handle a RSP write memory (binary) request
+//! Handle a RSP vCont request
 
 //! Syntax is:
 
-//!   X<addr>,<length>:
+//!   vCont?
+//!   vCont;<action>[:<tid>];<action>[:<tid>]...
 
-//! Followed by the specified number of bytes as raw binary. Response should be
-//! "OK" if all copied OK, E<nn> if error <nn> has occurred.
+//! The first asks which actions we support. The actions are c and s, C and
+//! S (where we ignore the signal, as for the c and s packets), t to stop,
+//! and r<start>,<end> to step while the PC is in the range [start, end).
 
-//! The length given is the number of bytes to be written. The data buffer has
-//! already been unescaped, so will hold this number of bytes.
+//! We only have one thread, so we carry out the first action which has no
+//! thread id, or has our thread id or -1 (all threads).
+
+//! In non-stop mode, the reply is OK and the stop is reported later with a
+//! notification. Steps are still done straight away, but a continue is left
+//! to the server loop, so GDB can carry on sending packets while the target
+//! runs.
 
 void
-GdbServerImpl::rspWriteMemBin ()
+GdbServerImpl::rspVCont ()
 {
-  uint32_t  addr;			// Where to write the memory
-  std::size_t len;			// Number of bytes to write
-
-  if (2 != sscanf (pkt->data, "X%x,%lx:", &addr, &len))
+  if (0 == strcmp ("vCont?", pkt->data))
     {
-      cerr << "Warning: Failed to recognize RSP write memory command: %s"
-	   << pkt->data << endl;
-      pkt->packStr ("E01");
+      pkt->packStr ("vCont;c;C;s;S;t;r");
       rsp->putPkt (pkt);
       return;
     }
 
-  // Find the start of the data and "unescape" it.
-  uint8_t *bindat = (uint8_t *)(memchr (pkt->data, ':',
-					pkt->getBufSize ())) + 1;
-  int   off       = (char *)bindat - pkt->data;
-  std::size_t newLen
-    = Utils::rspUnescape ((char *)bindat, pkt->getLen () - off);
-
-  // Sanity check
-  if (newLen != len)
+  for (char *action = strchr (pkt->data, ';');
+       nullptr != action;
+       action = strchr (action, ';'))
     {
-      int  minLen = len < newLen ? len : newLen;
+      action++;
 
-      cerr << "Warning: Write of " << len << " bytes requested, but "
-	   << newLen << " bytes supplied. " << minLen << " will be written"
-	   << endl;
-      len = minLen;
-    }
+      // Skip actions for threads other than ours.
+      char *colon = strchr (action, ':');
+      char *next  = strchr (action, ';');
 
-  // Write the bytes to memory.
-  if (len != cpu->write (addr, bindat, len))
-    cerr << "Warning: Failed to write " << len << " bytes to 0x" << hex
-	 << addr << dec << endl;
+      if ((nullptr != colon) && ((nullptr == next) || (colon < next)))
+	{
+	  long int  tid = strtol (colon + 1, nullptr, 16);
 
-  pkt->packStr ("OK");
+	  if ((-1 != tid) && (DUMMY_TID != tid))
+	    continue;
+	}
+
+      uint32_t  start;
+      uint32_t  end;
+
+      switch (action[0])
+	{
+	case 'c':
+	case 'C':
+	  // In non-stop mode, the server loop runs the target.
+	  if (!rspNonStopResume ())
+	    rspContinue ();
+
+	  return;
+
+	case 's':
+	case 'S':
+	  (void) rspNonStopResume ();
+	  rspSingleStep ();
+	  return;
+
+	case 't':
+	  if (mNonStop)
+	    {
+	      pkt->packStr ("OK");
+	      rsp->putPkt (pkt);
+	      rspNonStopStop (TargetSignal::NONE);
+	    }
+	  else
+	    rspReportException (TargetSignal::NONE);
+
+	  return;
+
+	case 'r':
+	  if (2 == sscanf (action, "r%x,%x", &start, &end))
+	    {
+	      (void) rspNonStopResume ();
+	      rspRangeStep (start, end);
+	      return;
+	    }
+
+	  break;
+
+	default:
+	  break;
+	}
+
+      cerr << "Warning: Unknown RSP vCont action: " << pkt->data << endl;
+      break;
+    }
+
+  pkt->packStr ("E01");
   rsp->putPkt (pkt);
 
-}	// rspWriteMemBin ()
+}	// rspVCont ()
 
 
-//! Handle a RSP remove breakpoint or matchpoint request
+//! Handle a RSP flash erase request
 
-//! This checks that the matchpoint was actually set earlier. For software
-//! (memory) breakpoints, the breakpoint is cleared from memory.
+//! Syntax is:
 
-//! @todo This doesn't work with icache/immu yet
+//!   vFlashErase:<addr>,<length>
+
+//! Our flash is really RAM, so there is nothing to erase. We just check the
+//! area is flash.
 
 void
-GdbServerImpl::rspRemoveMatchpoint ()
+GdbServerImpl::rspFlashErase ()
 {
-  MpType    type;			// What sort of matchpoint
-  uint32_t  addr;			// Address specified
-  uint32_t  instr;			// Instruction value found
-  std::size_t len;			// Matchpoint length
-  uint8_t  *instrVec;			// Instruction as byte vector
+  uint32_t  addr;
+  uint32_t  len;
 
-  pkt->packStr ("");
-  rsp->putPkt (pkt);
-  return;
-
-  // Break out the instruction
-  string ui32Fmt = SCNx32;
-  string fmt = "z%1d,%" + ui32Fmt + ",%1d";
-  if (3 != sscanf (pkt->data, fmt.c_str(), (int *)&type, &addr, &len))
+  if (2 != sscanf (pkt->data, "vFlashErase:%x,%x", &addr, &len))
     {
-      cerr << "Warning: RSP matchpoint deletion request not "
-	   << "recognized: ignored" << endl;
+      cerr << "Warning: Failed to recognize RSP flash erase command: "
+	   << pkt->data << endl;
       pkt->packStr ("E01");
       rsp->putPkt (pkt);
       return;
     }
 
-  // Sanity check len
-  if (len > sizeof (instr))
+  const MemoryMap::Region *r = mMemoryMap.find (addr);
+
+  if ((nullptr == r) || (MemoryMap::Type::FLASH != r->type)
+      || ((uint64_t) addr + len > (uint64_t) r->start + r->length))
     {
-      cerr << "Warning: RSP remove breakpoint instruction length " << len
-	   << " exceeds maximum of " << sizeof (instr) << endl;
+      cerr << "Warning: RSP flash erase outside flash: " << pkt->data
+	   << endl;
       pkt->packStr ("E01");
       rsp->putPkt (pkt);
       return;
     }
 
-  // Sort out the type of matchpoint
-  switch (type)
+  pkt->packStr ("OK");
+  rsp->putPkt (pkt);
+
+}	// rspFlashErase ()
+
+
+//! Handle a RSP flash write request
+
+//! Syntax is:
+
+//!   vFlashWrite:<addr>:<data>
+
+//! The data is binary, and has already been unescaped by the connection. It
+//! is staged until vFlashDone. GDB writes an image in address order, so data
+//! which follows on from the previous write is added to the same block.
+
+void
+GdbServerImpl::rspFlashWrite ()
+{
+  uint32_t  addr;
+  char     *colon = (char *) memchr (pkt->data + strlen ("vFlashWrite:"), ':',
+				     pkt->getLen () - strlen ("vFlashWrite:"));
+
+  if ((nullptr == colon)
+      || (1 != sscanf (pkt->data, "vFlashWrite:%x:", &addr)))
     {
-    case BP_MEMORY:
-      // Software (memory) breakpoint
-      if (mpHash->remove (type, addr, &instr))
-	{
-	  if (traceFlags->traceRsp())
-	    {
-	      cout << "RSP trace: software (memory) breakpoint removed from 0x"
-		   << hex << addr << dec << endl;
-	    }
-	}
-      else
+      cerr << "Warning: Failed to recognize RSP flash write command: "
+	   << pkt->data << endl;
+      pkt->packStr ("E01");
+      rsp->putPkt (pkt);
+      return;
+    }
+
+  uint8_t  *data = (uint8_t *) colon + 1;
+  uint32_t  len  = pkt->getLen () - (colon + 1 - pkt->data);
+  const MemoryMap::Region *r = mMemoryMap.find (addr);
+
+  if ((nullptr == r) || (MemoryMap::Type::FLASH != r->type)
+      || ((uint64_t) addr + len > (uint64_t) r->start + r->length))
+    {
+      pkt->packStr ("E.memtype");
+      rsp->putPkt (pkt);
+      return;
+    }
+
+  if (!mFlashStage.empty ()
+      && ((uint64_t) mFlashStage.back ().first
+	  + mFlashStage.back ().second.size () == addr))
+    {
+      std::vector<uint8_t> &block = mFlashStage.back ().second;
+      block.insert (block.end (), data, data + len);
+    }
+  else
+    mFlashStage.emplace_back (addr, std::vector<uint8_t> (data, data + len));
+
+  pkt->packStr ("OK");
+  rsp->putPkt (pkt);
+
+}	// rspFlashWrite ()
+
+
+//! Handle a RSP flash done request
+
+//! Write all the staged data to the target, with one write for each
+//! contiguous block, in the order it was written by GDB.
+
+void
+GdbServerImpl::rspFlashDone ()
+{
+  bool  ok = true;
+
+  for (auto const &block : mFlashStage)
+    {
+      std::size_t  len = block.second.size ();
+
+      rspUnplantBreakpoints (block.first, len);
+
+      if (cpu->write (block.first, block.second.data (), len) != len)
 	{
-	  cerr << "Warning: failed to remove software (memory) breakpoint "
-	          "from 0x" << hex << addr << dec << endl;
-	  pkt->packStr ("E01");
-	  rsp->putPkt (pkt);
+	  cerr << "Warning: Failed to write " << len << " bytes of flash at 0x"
+	       << hex << block.first << dec << endl;
+	  ok = false;
 	}
+    }
 
-      if (traceFlags->traceBreak ())
-	cerr << "Putting back the instruction (0x" << hex << setfill ('0')
-	     << setw (4) << instr << ") at 0x" << setw(8) << addr
-	     << setfill (' ')  << setw (0) << dec << endl;
+  mFlashStage.clear ();
+  pkt->packStr (ok ? "OK" : "E01");
+  rsp->putPkt (pkt);
 
-      // Remove the breakpoint from memory. The endianness of the instruction
-      // matches that of the memory.
-      instrVec = reinterpret_cast<uint8_t *> (&instr);
+}	// rspFlashDone ()
 
-      if (len != cpu->write (addr, instrVec, len))
-	cerr << "Warning: Failed to write memory removing breakpoint" << endl;
 
-      pkt->packStr ("OK");
+//! Handle a RSP read of the memory map
+
+//! Syntax is:
+
+//!   qXfer:memory-map:read::<offset>,<length>
+
+//! The reply is 'm' followed by part of the XML document if there is more
+//! to come, or 'l' followed by the last part.
+
+void
+GdbServerImpl::rspMemoryMapRead ()
+{
+  unsigned int  offset;
+  unsigned int  len;
+
+  if (mMemoryMap.empty ())
+    {
+      pkt->packStr ("");		// Not supported
+      rsp->putPkt (pkt);
+      return;
+    }
+
+  if (2 != sscanf (pkt->data, "qXfer:memory-map:read::%x,%x", &offset, &len))
+    {
+      cerr << "Warning: Failed to recognize RSP memory map read: "
+	   << pkt->data << endl;
+      pkt->packStr ("E00");
+      rsp->putPkt (pkt);
+      return;
+    }
+
+  string  xml = mMemoryMap.xml ();
+
+  if (offset > xml.size ())
+    offset = xml.size ();
+
+  if (len > xml.size () - offset)
+    len = xml.size () - offset;
+
+  if (len > RSP_PKT_SIZE - 1)
+    len = RSP_PKT_SIZE - 1;
+
+  pkt->reserve (len + 2);
+  pkt->data[0] = (offset + len < xml.size ()) ? 'm' : 'l';
+  memcpy (pkt->data + 1, xml.data () + offset, len);
+  pkt->data[len + 1] = '\0';
+  pkt->setLen (len + 1);
+  rsp->putPkt (pkt);
+
+}	// rspMemoryMapRead ()
+
+
+//! Handle a RSP write memory (binary) request
+
+//! Syntax is:
+
+//!   X<addr>,<length>:
+
+//! Followed by the specified number of bytes as raw binary. Response should be
+//! "OK" if all copied OK, E<nn> if error <nn> has occurred.
+
+//! The length given is the number of bytes to be written. The data buffer has
+//! already been unescaped by the connection, while we were busy with the
+//! previous packet, so will hold this number of bytes.
+
+void
+GdbServerImpl::rspWriteMemBin ()
+{
+  uint32_t  addr;			// Where to write the memory
+  std::size_t len;			// Number of bytes to write
+
+  if (2 != sscanf (pkt->data, "X%x,%lx:", &addr, &len))
+    {
+      cerr << "Warning: Failed to recognize RSP write memory command: %s"
+	   << pkt->data << endl;
+      pkt->packStr ("E01");
+      rsp->putPkt (pkt);
+      return;
+    }
+
+  // Find the start of the data. The connection has already unescaped it.
+  char *colon = (char *) memchr (pkt->data, ':', pkt->getLen ());
+
+  if (nullptr == colon)
+    {
+      cerr << "Warning: No data in RSP write memory command: "
+	   << pkt->data << endl;
+      pkt->packStr ("E01");
       rsp->putPkt (pkt);
       return;
+    }
+
+  uint8_t *bindat = (uint8_t *) colon + 1;
+  int   off       = (char *)bindat - pkt->data;
+  std::size_t newLen = pkt->getLen () - off;
+
+  // Sanity check
+  if (newLen != len)
+    {
+      int  minLen = len < newLen ? len : newLen;
+
+      cerr << "Warning: Write of " << len << " bytes requested, but "
+	   << newLen << " bytes supplied. " << minLen << " will be written"
+	   << endl;
+      len = minLen;
+    }
+
+  // Write nothing unless it is all in memory.
+  if (validLength (addr, len) < len)
+    {
+      pkt->packStr ("E01");
+      rsp->putPkt (pkt);
+      return;
+    }
 
+  // Write the bytes to memory.
+  rspUnplantBreakpoints (addr, len);
+
+  if (len != cpu->write (addr, bindat, len))
+    cerr << "Warning: Failed to write " << len << " bytes to 0x" << hex
+	 << addr << dec << endl;
+
+  pkt->packStr ("OK");
+  rsp->putPkt (pkt);
+
+}	// rspWriteMemBin ()
+
+
+//! Handle a RSP remove breakpoint or matchpoint request
+
+//! This checks that the matchpoint was actually set earlier. For software
+//! (memory) and hardware breakpoints, the breakpoint is only marked as
+//! removed. Memory is put back the next time the target is resumed (@see
+//! rspCommitBreakpoints ()).
+
+//! @todo This doesn't work with icache/immu yet
+
+void
+GdbServerImpl::rspRemoveMatchpoint ()
+{
+  MpType    type;			// What sort of matchpoint
+  uint32_t  addr;			// Address specified
+  uint32_t  instr;			// Instruction value found
+  unsigned int  len;			// Matchpoint length
+  MpEntry  *mp;				// The breakpoint entry
+
+  // Break out the instruction
+  string ui32Fmt = SCNx32;
+  string fmt = "z%1d,%" + ui32Fmt + ",%1u";
+  if (3 != sscanf (pkt->data, fmt.c_str(), (int *)&type, &addr, &len))
+    {
+      cerr << "Warning: RSP matchpoint deletion request not "
+	   << "recognized: ignored" << endl;
+      pkt->packStr ("E01");
+      rsp->putPkt (pkt);
+      return;
+    }
+
+  // Sanity check len
+  if (len > sizeof (instr))
+    {
+      cerr << "Warning: RSP remove breakpoint instruction length " << len
+	   << " exceeds maximum of " << sizeof (instr) << endl;
+      pkt->packStr ("E01");
+      rsp->putPkt (pkt);
+      return;
+    }
+
+  // How breakpoints are named in messages
+  const char *bpName =
+    (BP_HARDWARE == type) ? "hardware" : "software (memory)";
+
+  // Sort out the type of matchpoint
+  switch (type)
+    {
+    case BP_MEMORY:
     case BP_HARDWARE:
-      // Hardware breakpoint
-      if (mpHash->remove (type, addr, &instr))
+      // Software (memory) or hardware breakpoint. Both are planted by us,
+      // and share an entry.
+      mp = mpHash->lookup (BP_MEMORY, addr);
+
+      if ((nullptr == mp)
+	  || !((BP_MEMORY == type) ? mp->inserted : mp->hwInserted))
 	{
-	  if (traceFlags->traceRsp())
-	    {
-	      cout << "Rsp trace: hardware breakpoint removed from 0x NOT IMPLEMENTED"
-		   << hex << addr << dec << endl;
-	    }
-      /*
-	  cpu->removeBreak(addr);
-	  */
-	  pkt->packStr ("OK");
+	  cerr << "Warning: failed to remove " << bpName
+	       << " breakpoint from 0x" << hex << addr << dec << endl;
+	  pkt->packStr ("E01");
 	  rsp->putPkt (pkt);
+	  return;
 	}
+
+      if (BP_MEMORY == type)
+	mp->inserted = false;
       else
+	mp->hwInserted = false;
+
+      mBpDirty.insert (addr);
+
+      if (traceFlags->traceRsp())
 	{
-	  cerr << "Warning: failed to remove hardware breakpoint from 0x"
+	  cout << "RSP trace: " << bpName << " breakpoint removed from 0x"
 	       << hex << addr << dec << endl;
-	  pkt->packStr ("E01");
-	  rsp->putPkt (pkt);
 	}
 
+      pkt->packStr ("OK");
+      rsp->putPkt (pkt);
       return;
 
     case WP_WRITE:
-      // Write watchpoint
-      if (mpHash->remove (type, addr, &instr))
-	{
-	  if (traceFlags->traceRsp())
-	    {
-	      cout << "RSP trace: write watchpoint removed from 0x"
-		   << hex << addr << dec << endl;
-	    }
-
-	  pkt->packStr ("");		// TODO: Not yet implemented
-	  rsp->putPkt (pkt);
-	}
-      else
+      // Write watchpoint. Not yet implemented, so never recorded.
+      if (traceFlags->traceRsp())
 	{
-	  cerr << "Warning: failed to remove write watchpoint from 0x"
-	       << hex << addr << dec << endl;
-	  pkt->packStr ("E01");
-	  rsp->putPkt (pkt);
+	  cout << "RSP trace: write watchpoint removal from 0x" << hex << addr
+	       << dec << " not supported" << endl;
 	}
 
+      pkt->packStr ("");		// TODO: Not yet implemented
+      rsp->putPkt (pkt);
       return;
 
     case WP_READ:
-      // Read watchpoint
-      if (mpHash->remove (type, addr, &instr))
-	{
-	  if (traceFlags->traceRsp())
-	    {
-	      cout << "RSP trace: read watchpoint removed from 0x"
-		   << hex << addr << dec << endl;
-	    }
-
-	  pkt->packStr ("");		// TODO: Not yet implemented
-	  rsp->putPkt (pkt);
-	}
-      else
+      // Read watchpoint. Not yet implemented, so never recorded.
+      if (traceFlags->traceRsp())
 	{
-	  cerr << "Warning: failed to remove read watchpoint from 0x"
-	       << hex << addr << dec << endl;
-	  pkt->packStr ("E01");
-	  rsp->putPkt (pkt);
+	  cout << "RSP trace: read watchpoint removal from 0x" << hex << addr
+	       << dec << " not supported" << endl;
 	}
 
+      pkt->packStr ("");		// TODO: Not yet implemented
+      rsp->putPkt (pkt);
       return;
 
     case WP_ACCESS:
-      // Access (read/write) watchpoint
-      if (mpHash->remove (type, addr, &instr))
-	{
-	  if (traceFlags->traceRsp())
-	    {
-	      cout << "RSP trace: access (read/write) watchpoint removed "
-		      "from 0x" << hex << addr << dec << endl;
-	    }
-
-	  pkt->packStr ("");		// TODO: Not yet implemented
-	  rsp->putPkt (pkt);
-	}
-      else
+      // Access (read/write) watchpoint. Not yet implemented, so never
+      // recorded.
+      if (traceFlags->traceRsp())
 	{
-	  cerr << "Warning: failed to remove access (read/write) watchpoint "
-	          "from 0x" << hex << addr << dec << endl;
-	  pkt->packStr ("E01");
-	  rsp->putPkt (pkt);
+	  cout << "RSP trace: access (read/write) watchpoint removal from 0x"
+	       << hex << addr << dec << " not supported" << endl;
 	}
 
+      pkt->packStr ("");		// TODO: Not yet implemented
+      rsp->putPkt (pkt);
       return;
 
     default:
@@ -1645,7 +2727,20 @@ GdbServerImpl::rspRemoveMatchpoint ()
 
 //! Handle a RSP insert breakpoint or matchpoint request
 
-//! @todo For now only memory breakpoints are handled
+//! For software (memory) and hardware breakpoints, this only records the
+//! breakpoint, with the length of the instruction to replace. The
+//! breakpoint instruction is written the next time the target is resumed
+//! (@see rspCommitBreakpoints ()).
+
+//! A breakpoint may have conditions and commands, as agent expressions:
+
+//!   Z0,<addr>,<kind>;X<len>,<bytecode>...;cmds:<persist>,X<len>,<bytecode>...
+
+//! These are evaluated when the breakpoint is hit (@see rspBreakpointHit
+//! ()). GDB sends all the conditions and commands each time it inserts the
+//! breakpoint, so they replace any we had.
+
+//! @todo For now watchpoints are not handled
 
 void
 GdbServerImpl::rspInsertMatchpoint ()
@@ -1653,16 +2748,12 @@ GdbServerImpl::rspInsertMatchpoint ()
   MpType    type;			// What sort of matchpoint
   uint32_t  addr;			// Address specified
   uint32_t  instr;			// Instruction value found
-  std::size_t len;			// Matchpoint length
-  uint8_t  *instrVec;			// Instruction as byte vector
-
-  pkt->packStr ("");
-  rsp->putPkt (pkt);
-  return;
+  unsigned int  len;			// Matchpoint length
+  MpEntry  *mp;				// The breakpoint entry
 
   // Break out the instruction
   string ui32Fmt = SCNx32;
-  string fmt = "Z%1d,%" + ui32Fmt + ",%1d";
+  string fmt = "Z%1d,%" + ui32Fmt + ",%1u";
   if (3 != sscanf (pkt->data, fmt.c_str(), (int *)&type, &addr, &len))
     {
       cerr << "Warning: RSP matchpoint insertion request not "
@@ -1682,37 +2773,56 @@ GdbServerImpl::rspInsertMatchpoint ()
       return;
     }
 
+  // How breakpoints are named in messages
+  const char *bpName =
+    (BP_HARDWARE == type) ? "hardware" : "software (memory)";
+
   // Sort out the type of matchpoint
   switch (type)
     {
     case BP_MEMORY:
-      // Software (memory) breakpoint. Extract the instruction.
-      instrVec = reinterpret_cast<uint8_t *> (&instr);
+    case BP_HARDWARE:
+      // Software (memory) or hardware breakpoint. We have no hardware
+      // breakpoints, but GDB asks for them in flash, where it cannot write
+      // a breakpoint itself. We can, so both are EBREAK or C.EBREAK planted
+      // by us, sharing one entry. The whole instruction must be in memory.
+      if (((2 != len) && (4 != len)) || (validLength (addr, len) < len))
+	{
+	  cerr << "Warning: Cannot insert a " << len << " byte " << bpName
+	       << " breakpoint at 0x" << hex << addr << dec << endl;
+	  pkt->packStr ("E01");
+	  rsp->putPkt (pkt);
+	  return;
+	}
 
-      if (len != cpu->read (addr, instrVec, len))
-	cerr << "Warning: Failed to read memory when inserting breakpoint"
-	     << endl;
+      if (!rspParsePointOptions (addr))
+	{
+	  cerr << "Warning: Bad condition or command for " << bpName
+	       << " breakpoint at 0x" << hex << addr << dec << endl;
+	  pkt->packStr ("E01");
+	  rsp->putPkt (pkt);
+	  return;
+	}
 
-      // Record the breakpoint and write a breakpoint instruction in its
-      // place.
-      mpHash->add (type, addr, instr);
+      mp = mpHash->add (BP_MEMORY, addr, 0);
 
-      if (traceFlags->traceBreak ())
-	cerr << "Inserting a breakpoint over the  instruction (0x" << hex
-	     << setfill ('0') << setw (4) << instr << ") at 0x" << setw(8)
-	     << addr << setfill (' ')  << setw (0) << dec << endl;
+      // A breakpoint of a different size must be taken out of memory, so
+      // it can be put back with the right instruction.
+      if (mp->len != len)
+	rspUnplantBreakpoints (addr, 1);
 
-      // Little-endian, so least significant byte is at "little" address.
+      mp->len = len;
 
-      instr = BREAK_INSTR;
-      instrVec = reinterpret_cast<uint8_t *> (&instr);
+      if (BP_MEMORY == type)
+	mp->inserted = true;
+      else
+	mp->hwInserted = true;
 
-      if (4 != cpu->write (addr, instrVec, 4))
-	cerr << "Warning: Failed to write BREAK instruction" << endl;
+      mBpDirty.insert (addr);
 
       if (traceFlags->traceRsp())
 	{
-	  cout << "RSP trace: software (memory) breakpoint inserted at 0x"
+	  cout << "RSP trace: " << bpName << " breakpoint inserted at 0x"
 	       << hex << addr << dec << endl;
 	}
 
@@ -1720,31 +2830,13 @@ GdbServerImpl::rspInsertMatchpoint ()
       rsp->putPkt (pkt);
       return;
 
-    case BP_HARDWARE:
-      // Hardware breakpoint
-      mpHash->add (type, addr, 0);	// No instr for HW matchpoints
-
-      if (traceFlags->traceRsp())
-	{
-	  cout << "RSP trace: hardware breakpoint set at 0x NOT IMPLEMENTED"
-	       << hex << addr << dec << endl;
-	}
-      /*
-      cpu->insertBreak(addr);
-      */
-      pkt->packStr ("OK");
-      rsp->putPkt (pkt);
-
-      return;
-
     case WP_WRITE:
-      // Write watchpoint
-      mpHash->add (type, addr, 0);	// No instr for HW matchpoints
-
+      // Write watchpoint. Not yet implemented, so not recorded, since
+      // GDB will not remove a matchpoint it could not insert.
       if (traceFlags->traceRsp())
 	{
-	  cout << "RSP trace: write watchpoint set at 0x"
-	       << hex << addr << dec << endl;
+	  cout << "RSP trace: write watchpoint at 0x" << hex << addr << dec
+	       << " not supported" << endl;
 	}
 
       pkt->packStr ("");		// TODO: Not yet implemented
@@ -1753,13 +2845,12 @@ GdbServerImpl::rspInsertMatchpoint ()
       return;
 
     case WP_READ:
-      // Read watchpoint
-      mpHash->add (type, addr, 0);	// No instr for HW matchpoints
-
+      // Read watchpoint. Not yet implemented, so not recorded, since
+      // GDB will not remove a matchpoint it could not insert.
       if (traceFlags->traceRsp())
 	{
-	  cout << "RSP trace: read watchpoint set at 0x"
-	       << hex << addr << dec << endl;
+	  cout << "RSP trace: read watchpoint at 0x" << hex << addr << dec
+	       << " not supported" << endl;
 	}
 
       pkt->packStr ("");		// TODO: Not yet implemented
@@ -1768,13 +2859,13 @@ GdbServerImpl::rspInsertMatchpoint ()
       return;
 
     case WP_ACCESS:
-      // Access (read/write) watchpoint
-      mpHash->add (type, addr, 0);	// No instr for HW matchpoints
-
+      // Access (read/write) watchpoint. Not yet implemented, so not
+      // recorded, since GDB will not remove a matchpoint it could not
+      // insert.
       if (traceFlags->traceRsp())
 	{
-	  cout << "RSP trace: access (read/write) watchpoint set at 0x"
-	       << hex << addr << dec << endl;
+	  cout << "RSP trace: access (read/write) watchpoint at 0x" << hex
+	       << addr << dec << " not supported" << endl;
 	}
 
       pkt->packStr ("");		// TODO: Not yet implemented
@@ -1792,6 +2883,380 @@ GdbServerImpl::rspInsertMatchpoint ()
 }	// rspInsertMatchpoint ()
 
 
+//! Read the conditions and commands of a Z0 or Z1 packet
+
+//! GDB runs the expressions of each list together, but we also allow a ';'
+//! between them. Any conditions and commands replace those the breakpoint
+//! had. If there are none, the breakpoint no longer has them.
+
+//! Whether the commands should persist once GDB has gone is ignored, since
+//! we remove all breakpoints then.
+
+//! @param[in] addr  The address of the breakpoint.
+//! @return  TRUE if the options were read, FALSE if any was malformed, in
+//!          which case the breakpoint keeps its old ones.
+
+bool
+GdbServerImpl::rspParsePointOptions (uint32_t  addr)
+{
+  vector<AgentExpr>   conds;
+  vector<AgentExpr>   cmds;
+  vector<AgentExpr>  *exprs = &conds;
+
+  for (const char *p = strchr (pkt->data, ';');
+       (nullptr != p) && ('\0' != *p); )
+    {
+      if (';' == *p)
+	p++;
+      else if ('X' == *p)
+	{
+	  exprs->emplace_back ();
+	  p++;
+
+	  if (!exprs->back ().parse (p))
+	    return  false;
+	}
+      else if (0 == strncmp ("cmds:", p, strlen ("cmds:")))
+	{
+	  // Skip the persist flag
+	  p = strchr (p, ',');
+
+	  if (nullptr == p)
+	    return  false;
+
+	  p++;
+	  exprs = &cmds;
+	}
+      else
+	return  false;
+    }
+
+  if (conds.empty ())
+    mBpConds.erase (addr);
+  else
+    mBpConds[addr] = std::move (conds);
+
+  if (cmds.empty ())
+    mBpCmds.erase (addr);
+  else
+    mBpCmds[addr] = std::move (cmds);
+
+  return  true;
+
+}	// rspParsePointOptions ()
+
+
+//! Decide whether to report a stop at a breakpoint
+
+//! If the target has stopped at one of our breakpoints which has
+//! conditions, they are evaluated here, rather than by GDB. If any is true,
+//! or cannot be evaluated, the stop is reported as usual.
+
+//! If the breakpoint has commands, and is not stopped for by its
+//! conditions, the commands are run here too. This is a dprintf, so the
+//! output is kept to be sent on, and the stop is not reported, unless a
+//! command fails.
+
+//! When the stop is not reported, the replaced instruction is stepped, with
+//! the breakpoint put back afterwards, and the target can carry on without
+//! GDB knowing.
+
+//! @return  TRUE if the stop should be reported, FALSE if the target has
+//!          been stepped past the breakpoint.
+
+bool
+GdbServerImpl::rspBreakpointHit ()
+{
+  uint_reg_t  pc;
+
+  if ((mBpConds.empty () && mBpCmds.empty ())
+      || (0 == cpu->readRegister (RISCV_PC_REGNUM, pc)))
+    return  true;
+
+  auto     condIt = mBpConds.find (pc);
+  auto     cmdIt  = mBpCmds.find (pc);
+  MpEntry *mp     = mpHash->lookup (BP_MEMORY, pc);
+
+  if (((mBpConds.end () == condIt) && (mBpCmds.end () == cmdIt))
+      || (nullptr == mp) || (0 == mBpPlanted.count (pc)))
+    return  true;
+
+  bool  hit = (mBpConds.end () == condIt);
+
+  if (!hit)
+    for (auto const &cond : condIt->second)
+      {
+	uint64_t  val;
+
+	if (!cond.eval (cpu, val) || (0 != val))
+	  {
+	    hit = true;
+	    break;
+	  }
+      }
+
+  if (hit)
+    {
+      if (mBpCmds.end () == cmdIt)
+	return  true;
+
+      if (mDprintfBuf.empty ())
+	mDprintfStart = system_clock::now ();
+
+      for (auto const &cmd : cmdIt->second)
+	{
+	  uint64_t  val;
+
+	  if (!cmd.eval (cpu, val, &mDprintfBuf))
+	    {
+	      cerr << "Warning: Failed to run command of breakpoint at 0x"
+		   << hex << pc << dec << endl;
+	      return  true;
+	    }
+	}
+
+      rspFlushDprintf (false);
+    }
+
+  // Step the replaced instruction, and put the breakpoint back.
+  uint32_t  breakInstr = 0;
+  uint8_t  *breakVec   = reinterpret_cast<uint8_t *> (&breakInstr);
+  uint8_t  *instrVec   = reinterpret_cast<uint8_t *> (&mp->instr);
+
+  if ((mp->len != cpu->read (pc, breakVec, mp->len))
+      || (mp->len != cpu->write (pc, instrVec, mp->len)))
+    return  true;
+
+  ITarget::ResumeRes  resType = cpu->resume (ITarget::ResumeType::STEP);
+
+  if (mp->len != cpu->write (pc, breakVec, mp->len))
+    cerr << "Warning: Failed to write BREAK instruction at 0x" << hex << pc
+	 << dec << endl;
+
+  return  ITarget::ResumeRes::STEPPED != resType;
+
+}	// rspBreakpointHit ()
+
+
+//! Send on dprintf output
+
+//! The output goes to the log file, if the user has given one. Otherwise it
+//! goes to GDB as an O packet, which GDB allows while the target is running
+//! in all-stop mode. In non-stop mode it does not, so the output goes to
+//! our standard error.
+
+//! Unless forced, the output is only sent once there is DPRINTF_BUF_SIZE of
+//! it, or the oldest has waited DPRINTF_FLUSH_MS. It is always sent before
+//! a stop is reported, so it comes before the stop.
+
+//! @param[in] force  TRUE to send whatever output there is.
+
+void
+GdbServerImpl::rspFlushDprintf (bool  force)
+{
+  if (mDprintfBuf.empty ()
+      || (!force && (mDprintfBuf.size () < DPRINTF_BUF_SIZE)
+	  && (system_clock::now () - mDprintfStart
+	      < duration <double> (DPRINTF_FLUSH_MS * 0.001))))
+    return;
+
+  if (mDprintfLog.is_open ())
+    mDprintfLog << mDprintfBuf << std::flush;
+  else if (mNonStop)
+    cerr << mDprintfBuf << std::flush;
+  else
+    {
+      pkt->packRcmdStr (mDprintfBuf.c_str (), true);
+      rsp->putPkt (pkt);
+    }
+
+  mDprintfBuf.clear ();
+
+}	// rspFlushDprintf ()
+
+
+//! Bring memory up to date with the software breakpoints GDB wants
+
+//! Called whenever the target is about to be resumed. Only breakpoints
+//! inserted or removed since the last time are looked at. So when GDB
+//! removes all its breakpoints at a stop and inserts them again before
+//! resuming, memory is not touched at all.
+
+//! A breakpoint which GDB wants, and is not in memory, has its instruction
+//! saved and replaced by EBREAK (or C.EBREAK). One which GDB has removed
+//! has its instruction put back, and is forgotten.
+
+void
+GdbServerImpl::rspCommitBreakpoints ()
+{
+  for (uint32_t  addr : mBpDirty)
+    {
+      MpEntry *mp      = mpHash->lookup (BP_MEMORY, addr);
+      bool     planted = mBpPlanted.count (addr) > 0;
+
+      if (nullptr == mp)
+	continue;
+
+      bool  wanted = mp->inserted || mp->hwInserted;
+
+      if (wanted && !planted)
+	{
+	  // Little-endian, so least significant byte is at "little" address.
+	  uint32_t  breakInstr = BREAK_INSTR;
+	  uint8_t  *breakVec   = reinterpret_cast<uint8_t *> (&breakInstr);
+	  uint8_t  *instrVec   = reinterpret_cast<uint8_t *> (&mp->instr);
+
+	  if (2 == mp->len)
+	    breakInstr = C_BREAK_INSTR;
+
+	  mp->instr = 0;
+
+	  if ((mp->len != cpu->read (addr, instrVec, mp->len))
+	      || (mp->len != cpu->write (addr, breakVec, mp->len)))
+	    {
+	      cerr << "Warning: Failed to write BREAK instruction at 0x" << hex
+		   << addr << dec << endl;
+	      continue;
+	    }
+
+	  mBpPlanted.insert (addr);
+
+	  if (traceFlags->traceBreak ())
+	    cerr << "Inserting a breakpoint over the  instruction (0x" << hex
+		 << setfill ('0') << setw (4) << mp->instr << ") at 0x"
+		 << setw(8) << addr << setfill (' ')  << setw (0) << dec
+		 << endl;
+	}
+      else if (!wanted)
+	{
+	  if (planted)
+	    {
+	      uint8_t  *instrVec = reinterpret_cast<uint8_t *> (&mp->instr);
+
+	      if (traceFlags->traceBreak ())
+		cerr << "Putting back the instruction (0x" << hex
+		     << setfill ('0') << setw (4) << mp->instr << ") at 0x"
+		     << setw(8) << addr << setfill (' ')  << setw (0) << dec
+		     << endl;
+
+	      if (mp->len != cpu->write (addr, instrVec, mp->len))
+		cerr << "Warning: Failed to write memory removing breakpoint"
+		     << endl;
+
+	      mBpPlanted.erase (addr);
+	    }
+
+	  mpHash->remove (BP_MEMORY, addr);
+	  mBpConds.erase (addr);
+	  mBpCmds.erase (addr);
+	}
+    }
+
+  mBpDirty.clear ();
+
+}	// rspCommitBreakpoints ()
+
+
+//! Take software breakpoints out of memory before it is written
+
+//! Any breakpoint instruction in memory which overlaps the range has the
+//! instruction it replaced put back, and is marked to be put in again when
+//! the target is next resumed. At that point the instruction is saved
+//! afresh, so it is the one GDB wrote.
+
+//! @param[in] addr  The first address to be written.
+//! @param[in] len   The number of bytes to be written.
+
+void
+GdbServerImpl::rspUnplantBreakpoints (uint32_t     addr,
+				      std::size_t  len)
+{
+  // A breakpoint starting up to 3 bytes before may overlap.
+  uint64_t  end = (uint64_t) addr + len;
+  auto      it  = mBpPlanted.lower_bound ((addr < 3) ? 0 : addr - 3);
+
+  while ((it != mBpPlanted.end ()) && (*it < end))
+    {
+      MpEntry *mp = mpHash->lookup (BP_MEMORY, *it);
+
+      if ((nullptr != mp) && ((uint64_t) *it + mp->len <= addr))
+	{
+	  ++it;
+	  continue;
+	}
+
+      if ((nullptr != mp)
+	  && (mp->len != cpu->write (*it,
+				     reinterpret_cast<uint8_t *> (&mp->instr),
+				     mp->len)))
+	cerr << "Warning: Failed to write memory removing breakpoint" << endl;
+
+      mBpDirty.insert (*it);
+      it = mBpPlanted.erase (it);
+    }
+}	// rspUnplantBreakpoints ()
+
+
+//! Hide software breakpoints in memory which has been read
+
+//! While a breakpoint instruction is in memory, GDB must see the
+//! instruction it replaced, just as if GDB had removed its breakpoints.
+
+//! @param[in]     addr  The address the memory was read from.
+//! @param[in,out] buf   The memory read.
+//! @param[in]     len   The number of bytes read.
+
+void
+GdbServerImpl::rspShadowBreakpoints (uint32_t     addr,
+				     uint8_t     *buf,
+				     std::size_t  len)
+{
+  // A breakpoint starting up to 3 bytes before may overlap.
+  uint64_t  end = (uint64_t) addr + len;
+
+  for (auto it = mBpPlanted.lower_bound ((addr < 3) ? 0 : addr - 3);
+       (it != mBpPlanted.end ()) && (*it < end);
+       ++it)
+    {
+      MpEntry *mp = mpHash->lookup (BP_MEMORY, *it);
+
+      if (nullptr == mp)
+	continue;
+
+      uint8_t  *instrVec = reinterpret_cast<uint8_t *> (&mp->instr);
+
+      for (uint32_t  i = 0; i < mp->len; i++)
+	{
+	  uint64_t  a = (uint64_t) *it + i;
+
+	  if ((a >= addr) && (a < end))
+	    buf[a - addr] = instrVec[i];
+	}
+    }
+}	// rspShadowBreakpoints ()
+
+
+//! Take all software breakpoints out of memory and forget them
+
+//! Used when GDB goes away, so the target is left with its own code, and a
+//! new GDB session starts afresh.
+
+void
+GdbServerImpl::rspRemoveAllBreakpoints ()
+{
+  while (!mBpPlanted.empty ())
+    rspUnplantBreakpoints (*mBpPlanted.begin (), 1);
+
+  for (uint32_t  addr : mBpDirty)
+    mpHash->remove (BP_MEMORY, addr);
+
+  mBpDirty.clear ();
+  mBpConds.clear ();
+  mBpCmds.clear ();
+
+}	// rspRemoveAllBreakpoints ()
+
+
 //! Output operator for TargetSignal enumeration
 
 //! @param[in] s  The stream to output to.
@@ -23,11 +23,17 @@
 #ifndef GDB_SERVER_IMPL_H
 #define GDB_SERVER_IMPL_H
 
+#include <atomic>
 #include <chrono>
 #include <cstdio>
+#include <fstream>
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <map>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 // General interface to targets
 
@@ -35,8 +41,11 @@
 
 // Class headers
 
+#include "AgentExpr.h"
 #include "GdbServer.h"
+#include "MemoryMap.h"
 #include "MpHash.h"
+#include "PacketStats.h"
 #include "RspConnection.h"
 #include "RspPacket.h"
 #include "TraceFlags.h"
@@ -69,6 +78,15 @@ public:
   bool command (const std::string  cmd,
 		std::ostream & stream);
 
+  // Flag set when GDB sends a break, for the target to poll
+
+  const std::atomic<bool> * breakFlag () const;
+
+  // Treat a region of memory as flash, for loading with vFlash packets
+
+  void  flashRegion (uint32_t  start,
+		     uint32_t  length);
+
 
 private:
 
@@ -94,16 +112,26 @@ private:
 
   static const int RISCV_NUM_REGS = 33;
 
+  // GDB numbers of the registers sent with each stop reply
+
+  static const int RISCV_RA_REGNUM = 1;		//!< Return address (x1)
+  static const int RISCV_SP_REGNUM = 2;		//!< Stack pointer (x2)
+  static const int RISCV_FP_REGNUM = 8;		//!< Frame pointer (s0)
+  static const int RISCV_PC_REGNUM = 32;	//!< Program counter
+
   //! Total bytes taken by regs. 4 bytes for each
 
   static const int RISCV_NUM_REG_BYTES = RISCV_NUM_REGS * sizeof (uint_reg_t);
 
-  //! Minimum packet size for RSP. Must be large enough for any initial
-  //! dialogue. Should at least allow all the registers ASCII encloded + end of
-  //! string marker.
+  //! The packet size for RSP, which we advertise to GDB in qSupported. This
+  //! is large, so GDB can load and dump memory in big blocks, and must at
+  //! least allow all the registers ASCII encoded. The packet buffer has one
+  //! more char for an end of string marker.
 
-  static const int RSP_PKT_SIZE = (RISCV_NUM_REG_BYTES * 2 + 1) < 256
-				    ? 256 : RISCV_NUM_REG_BYTES * 2 + 1;
+  static const int RSP_PKT_SIZE = 0x10000;
+
+  static_assert (RSP_PKT_SIZE >= RISCV_NUM_REG_BYTES * 2,
+		 "RSP packet size too small for all the registers");
 
   //! Constant for a thread id
 
@@ -113,11 +141,38 @@ private:
 
   static const uint32_t  BREAK_INSTR = 0x100073;
 
+  //! Constant for a compressed breakpoint (C.EBREAK), for GDB's two byte
+  //! breakpoints.
+
+  static const uint32_t  C_BREAK_INSTR = 0x9002;
+
   //! Constant which is the sample period (in instruction steps) during
   //! "continue" etc.
 
   static const int RUN_SAMPLE_PERIOD = 10000;
 
+  //! The erase block size we give GDB for flash regions. GDB erases whole
+  //! blocks, but since our "flash" is really RAM, this only affects how GDB
+  //! rounds the areas it erases.
+
+  static const uint32_t  FLASH_BLOCK_SIZE = 0x1000;
+
+  //! In non-stop mode, how long the target is run before the server looks
+  //! for packets from GDB, in milliseconds.
+
+  static const int  NON_STOP_SLICE_MS = 10;
+
+  //! How much dprintf output is kept, and for how long in milliseconds,
+  //! before it is sent on. Saves a packet for every dprintf.
+
+  static const std::size_t  DPRINTF_BUF_SIZE = 4096;
+  static const int          DPRINTF_FLUSH_MS = 100;
+
+  //! How much memory to read from the target at a time for qCRC and
+  //! qSearch:memory
+
+  static const std::size_t  MEM_BLOCK_SIZE = 0x10000;
+
   //! Our associated simulated CPU
   ITarget * cpu;
 
@@ -134,13 +189,48 @@ private:
   //! Hash table for matchpoints
   MpHash *mpHash;
 
+  //! Addresses of memory breakpoints whose breakpoint instruction is in
+  //! memory now
+  std::set<uint32_t>  mBpPlanted;
+
+  //! Addresses of memory breakpoints inserted or removed by GDB since
+  //! memory was last brought up to date
+  std::set<uint32_t>  mBpDirty;
+
+  //! Conditions of memory breakpoints which have them, from GDB. The
+  //! breakpoint is only reported if one of them is true.
+  std::map<uint32_t, std::vector<AgentExpr> >  mBpConds;
+
+  //! Commands of memory breakpoints which have them, from GDB. These are
+  //! the printf of a dprintf, run instead of reporting the breakpoint.
+  std::map<uint32_t, std::vector<AgentExpr> >  mBpCmds;
+
+  //! Output from dprintf commands not yet sent on, and when the oldest of
+  //! it was written.
+  std::string  mDprintfBuf;
+  std::chrono::time_point<std::chrono::system_clock,
+			  std::chrono::duration<double> >  mDprintfStart;
+
+  //! The file dprintf output is written to, and its name. If not open, the
+  //! output goes to GDB.
+  std::ofstream  mDprintfLog;
+  std::string    mDprintfLogName;
+
+  //! Statistics for the packets we handle
+  PacketStats *mPktStats;
+
+  //! The memory map we give GDB, as described by the target. Empty if the
+  //! target does not know its memory layout.
+  MemoryMap mMemoryMap;
+
+  //! Data from vFlashWrite packets, not yet written to the target. Each
+  //! entry is a contiguous block of data and its start address, in the
+  //! order they were written.
+  std::vector<std::pair<uint32_t, std::vector<uint8_t> > >  mFlashStage;
+
   //! Timeout for continue.
   std::chrono::duration<double> mTimeout;
 
-  //! The length of time to run before breaking out of the model to
-  //! check for an interrupt from GDB.
-  static const std::chrono::duration <double> interruptTimeout;
-
   //! How to behave when we get a kill (k) packet.
   GdbServer::KillBehaviour killBehaviour;
 
@@ -148,6 +238,18 @@ private:
 
   bool mExitServer;
 
+  //! Has GDB asked for non-stop mode (QNonStop:1)?
+  bool mNonStop;
+
+  //! In non-stop mode, is the target running? It is run a slice at a time
+  //! by the server loop, and its stop reported with a notification.
+  bool mRunning;
+
+  //! In non-stop mode, when the user's timeout for the current continue
+  //! runs out.
+  std::chrono::time_point<std::chrono::system_clock,
+			  std::chrono::duration<double> >  mRunEnd;
+
   //! What to do when we get a syscall reply.
   enum SyscallContinuationType
     {
@@ -158,30 +260,56 @@ private:
 
   // Main RSP request handler
   void  rspClientRequest ();
+  void  rspDispatch ();
 
   // Handle the various RSP requests
   int   stringLength (uint32_t addr);
+  std::size_t  validLength (uint32_t     addr,
+			    std::size_t  len) const;
   void  rspSyscallRequest (SyscallContinuationType);
   void  rspSyscallReply ();
   void  rspReportException (TargetSignal  sig = TargetSignal::TRAP);
   void  rspReadAllRegs ();
   void  rspWriteAllRegs ();
   void  rspReadMem ();
+  void  rspReadMemBin ();
   void  rspWriteMem ();
   void  rspReadReg ();
   void  rspWriteReg ();
   void  rspQuery ();
+  void  rspCrc ();
+  void  rspSearchMemory ();
   void  rspCommand ();
   void  rspSetCommand (const char* cmd);
   void  rspShowCommand (const char* cmd);
   void  rspSet ();
   void  rspRestart ();
   void  rspVpkt ();
+  void  rspVCont ();
+  void  rspFlashErase ();
+  void  rspFlashWrite ();
+  void  rspFlashDone ();
+  void  rspMemoryMapRead ();
   void  rspWriteMemBin ();
   void  rspRemoveMatchpoint ();
   void  rspInsertMatchpoint ();
+  bool  rspParsePointOptions (uint32_t  addr);
+  bool  rspBreakpointHit ();
+  void  rspFlushDprintf (bool  force);
+  void  rspCommitBreakpoints ();
+  void  rspUnplantBreakpoints (uint32_t     addr,
+			       std::size_t  len);
+  void  rspShadowBreakpoints (uint32_t     addr,
+			      uint8_t     *buf,
+			      std::size_t  len);
+  void  rspRemoveAllBreakpoints ();
   void  rspContinue ();
   void  rspSingleStep ();
+  void  rspRangeStep (uint32_t  start,
+		      uint32_t  end);
+  bool  rspNonStopResume ();
+  void  rspNonStopStop (TargetSignal  sig);
+  void  rspRunSlice ();
 
 };	// GdbServerImpl ()
 
@@ -0,0 +1,243 @@
+// GDB memory map: implementation
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <sstream>
+
+#include "MemoryMap.h"
+
+using std::hex;
+using std::ostringstream;
+using std::string;
+
+
+//! Constructor
+
+//! The map starts off empty.
+
+MemoryMap::MemoryMap ()
+{
+  // Nothing.
+
+}	// MemoryMap ()
+
+
+//! Destructor
+
+MemoryMap::~MemoryMap ()
+{
+  // Nothing.
+
+}	// ~MemoryMap ()
+
+
+//! Remove all the regions
+
+void
+MemoryMap::clear ()
+{
+  mRegions.clear ();
+
+}	// clear ()
+
+
+//! Add a region
+
+//! The caller must make sure regions do not overlap. Empty regions are
+//! ignored.
+
+//! @param[in] type       The type of memory.
+//! @param[in] start      The first address in the region.
+//! @param[in] length     The size of the region in bytes.
+//! @param[in] blockSize  The erase block size. Only used for flash.
+
+void
+MemoryMap::add (Type      type,
+		uint32_t  start,
+		uint64_t  length,
+		uint32_t  blockSize)
+{
+  if (0 == length)
+    return;
+
+  Region  r = { type, start, length, blockSize };
+  auto    it = std::upper_bound (mRegions.begin (), mRegions.end (), r,
+				 [] (const Region &a, const Region &b)
+				 { return a.start < b.start; });
+
+  mRegions.insert (it, r);
+
+}	// add ()
+
+
+//! Add a region over the top of those already there
+
+//! Any parts of existing regions which the new region covers are removed,
+//! splitting them if need be.
+
+//! @param[in] type       The type of memory.
+//! @param[in] start      The first address in the region.
+//! @param[in] length     The size of the region in bytes.
+//! @param[in] blockSize  The erase block size. Only used for flash.
+
+void
+MemoryMap::overlay (Type      type,
+		    uint32_t  start,
+		    uint64_t  length,
+		    uint32_t  blockSize)
+{
+  if (0 == length)
+    return;
+
+  uint64_t             end = (uint64_t) start + length;
+  std::vector<Region>  old;
+
+  old.swap (mRegions);
+
+  for (auto const &r : old)
+    {
+      uint64_t  rEnd = (uint64_t) r.start + r.length;
+
+      if ((rEnd <= start) || (r.start >= end))
+	mRegions.push_back (r);
+      else
+	{
+	  // Keep whatever sticks out either side
+	  if (r.start < start)
+	    mRegions.push_back ({ r.type, r.start, start - r.start,
+				  r.blockSize });
+	  if (rEnd > end)
+	    mRegions.push_back ({ r.type, (uint32_t) end, rEnd - end,
+				  r.blockSize });
+	}
+    }
+
+  add (type, start, length, blockSize);
+
+}	// overlay ()
+
+
+//! Is the map empty?
+
+//! @return  TRUE if there are no regions.
+
+bool
+MemoryMap::empty () const
+{
+  return  mRegions.empty ();
+
+}	// empty ()
+
+
+//! Find the region holding an address
+
+//! @param[in] addr  The address.
+//! @return  The region, or nullptr if the address is not in any region.
+
+const MemoryMap::Region *
+MemoryMap::find (uint32_t  addr) const
+{
+  auto  it = std::upper_bound (mRegions.begin (), mRegions.end (), addr,
+			       [] (uint32_t a, const Region &r)
+			       { return a < r.start; });
+
+  if (it == mRegions.begin ())
+    return  nullptr;
+
+  --it;
+
+  return  ((uint64_t) addr - it->start < it->length) ? &(*it) : nullptr;
+
+}	// find ()
+
+
+//! How much of a range of addresses is in the map
+
+//! Regions which abut are treated as one, so the range may cross from one
+//! region into the next.
+
+//! @param[in] addr  The first address in the range.
+//! @param[in] len   The size of the range in bytes.
+//! @return  The number of bytes from the start of the range which are in the
+//!          map. Zero if the first address is not.
+
+uint64_t
+MemoryMap::extent (uint32_t  addr,
+		   uint64_t  len) const
+{
+  uint64_t  end  = (uint64_t) addr + len;
+  uint64_t  next = addr;
+
+  for (const Region *r = find (addr);
+       (nullptr != r) && (next < end);
+       r = (next < ((uint64_t) 1 << 32)) ? find ((uint32_t) next) : nullptr)
+    next = (uint64_t) r->start + r->length;
+
+  return  ((next < end) ? next : end) - addr;
+
+}	// extent ()
+
+
+//! The map as XML, for qXfer:memory-map:read
+
+//! @return  The memory map document, as defined in the GDB manual.
+
+string
+MemoryMap::xml () const
+{
+  ostringstream  s;
+
+  s << "<?xml version=\"1.0\"?>\n"
+    << "<!DOCTYPE memory-map PUBLIC \"+//IDN gnu.org//DTD GDB Memory Map "
+    << "V1.0//EN\" \"http://sourceware.org/gdb/gdb-memory-map.dtd\">\n"
+    << "<memory-map>\n" << hex;
+
+  for (auto const &r : mRegions)
+    {
+      const char *type;
+
+      switch (r.type)
+	{
+	case Type::RAM:   type = "ram";   break;
+	case Type::ROM:   type = "rom";   break;
+	case Type::FLASH: type = "flash"; break;
+	default:          type = "ram";   break;
+	}
+
+      s << "  <memory type=\"" << type << "\" start=\"0x" << r.start
+	<< "\" length=\"0x" << r.length << "\"";
+
+      if (Type::FLASH == r.type)
+	s << ">\n    <property name=\"blocksize\">0x" << r.blockSize
+	  << "</property>\n  </memory>\n";
+      else
+	s << "/>\n";
+    }
+
+  s << "</memory-map>\n";
+  return  s.str ();
+
+}	// xml ()
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
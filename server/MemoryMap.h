@@ -0,0 +1,97 @@
+// GDB memory map: declaration
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MEMORY_MAP_H
+#define MEMORY_MAP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+//! The memory map we give to GDB
+
+//! A list of non-overlapping regions, each of RAM, ROM or flash, which is
+//! sent to GDB as XML in reply to qXfer:memory-map:read. GDB will only
+//! access memory within the map, and will only write to flash regions with
+//! the vFlash packets.
+
+class MemoryMap
+{
+public:
+
+  //! The type of a region, as GDB understands them
+
+  enum class Type
+  {
+    RAM,
+    ROM,
+    FLASH
+  };
+
+  //! One region of memory
+
+  struct Region
+  {
+    Type      type;
+    uint32_t  start;
+    uint64_t  length;			//!< Up to 4 GiB, so 64 bits
+    uint32_t  blockSize;		//!< Erase block size, for flash
+  };
+
+  // Constructor and destructor
+
+  MemoryMap ();
+  ~MemoryMap ();
+
+  // Build the map
+
+  void  clear ();
+  void  add (Type      type,
+	     uint32_t  start,
+	     uint64_t  length,
+	     uint32_t  blockSize = 0);
+  void  overlay (Type      type,
+		 uint32_t  start,
+		 uint64_t  length,
+		 uint32_t  blockSize = 0);
+
+  // Query the map
+
+  bool            empty () const;
+  const Region *  find (uint32_t  addr) const;
+  uint64_t        extent (uint32_t  addr,
+			  uint64_t  len) const;
+  std::string     xml () const;
+
+private:
+
+  //! The regions, sorted by start address
+
+  std::vector<Region>  mRegions;
+
+};	// MemoryMap ()
+
+#endif	// MEMORY_MAP_H
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
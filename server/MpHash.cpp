@@ -27,29 +27,39 @@
 
 //! Constructor
 
-//! Allocate the hash table
+//! Allocate the hash table, with all slots empty, and an empty bitmap.
 //! @param[in] size  Number of slots in the  hash table. Defaults to
-//!                  DEFAULT_MP_HASH_SIZE.
+//!                  DEFAULT_MP_HASH_SIZE. Rounded up to a power of 2.
 MpHash::MpHash (int  _size) :
-  size (_size)
+  mUsed (0),
+  mLive (0)
 {
-  // Allocate and clear the hash table
-  hashTab = new MpEntry *[size];
+  std::size_t  size = 8;
+
+  while ((int) size < _size)
+    size *= 2;
+
+  mSlots.assign (size, Slot {EMPTY_KEY, NULL});
+
+  for (std::size_t  i = 0; i < sizeof (mDir) / sizeof (mDir[0]); i++)
+    mDir[i] = NULL;
 
-  for (int  i = 0; i < size; i++)
-    {
-      hashTab[i] = NULL;
-    }
 }	// MpHash ()
 
 
 //! Destructor
 
-//! Free the hash table
+//! Free the bitmap. The table and entries look after themselves.
 MpHash::~MpHash ()
 {
-  delete [] hashTab;
-
+  for (std::size_t  i = 0; i < sizeof (mDir) / sizeof (mDir[0]); i++)
+    if (NULL != mDir[i])
+      {
+	for (int  j = 0; j < (1 << TABLE_BITS); j++)
+	  delete mDir[i]->pages[j];
+
+	delete mDir[i];
+      }
 }	// ~MpHash ()
 
 
@@ -60,38 +70,67 @@ MpHash::~MpHash ()
 //! a duplicate insertion (perhaps due to a lost packet) they will be
 //! different.
 
-//! @note This method allocates memory. Care must be taken to delete it when
-//! done.
+//! A new entry has its other fields cleared.
+
+//! The table is grown (or just cleared of deleted slots) if it would be
+//! more than a quarter full, so probes stay short.
 
 //! @param[in] type   The type of matchpoint
 //! @param[in] addr   The address of the matchpoint
 //! @para[in]  instr  The instruction to associate with the address
-void
+//! @return  The entry, whether new or already there
+MpEntry *
 MpHash::add (MpType    type,
 	     uint32_t  addr,
 	     uint32_t  instr)
 {
-  int      hv    = addr % size;
-  MpEntry *curr;
+  MpEntry *curr = lookup (type, addr);
+
+  if (NULL != curr)
+    return  curr;		// We already have the entry
+
+  if ((mUsed + 1) * 4 > mSlots.size ())
+    rehash (((mLive + 1) * 8 > mSlots.size ())
+	    ? mSlots.size () * 2 : mSlots.size ());
 
-  // See if we already have the entry
-  for(curr = hashTab[hv]; NULL != curr; curr = curr->next)
+  // Take an entry from the pool
+  if (mFree.empty ())
     {
-      if ((type == curr->type) && (addr == curr->addr))
-	{
-	  return;		// We already have the entry
-	}
+      mPool.emplace_back ();
+      curr = &mPool.back ();
+    }
+  else
+    {
+      curr = mFree.back ();
+      mFree.pop_back ();
     }
 
-  // Insert the new entry at the head of the chain
-  curr = new MpEntry ();
-  
+  *curr = MpEntry ();
   curr->type  = type;
   curr->addr  = addr;
   curr->instr = instr;
-  curr->next  = hashTab[hv];
 
-  hashTab[hv] = curr;
+  // Use the first free slot, deleted or never used
+  uint64_t     key  = makeKey (type, addr);
+  std::size_t  mask = mSlots.size () - 1;
+  std::size_t  i;
+
+  for (i = home (key);
+       (EMPTY_KEY != mSlots[i].key) && (DELETED_KEY != mSlots[i].key);
+       i = (i + 1) & mask)
+    ;
+
+  if (EMPTY_KEY == mSlots[i].key)
+    mUsed++;
+
+  mSlots[i].key   = key;
+  mSlots[i].entry = curr;
+  mLive++;
+
+  if ((BP_MEMORY == type) || (BP_HARDWARE == type))
+    setBreakBit (addr, true);
+
+  return  curr;
 
 }	// add ()
 
@@ -108,18 +147,9 @@ MpEntry *
 MpHash::lookup (MpType    type,
 		uint32_t  addr)
 {
-  int      hv   = addr % size;
-
-  // Search
-  for (MpEntry *curr = hashTab[hv]; NULL != curr; curr = curr->next)
-    {
-      if ((type == curr->type) && (addr == curr->addr))
-	{
-	  return  curr;		// The entry found
-	}
-    }
+  std::size_t  i = find (makeKey (type, addr));
 
-  return  NULL;			// Not found
+  return  (i < mSlots.size ()) ? mSlots[i].entry : NULL;
 
 }	// lookup ()
 
@@ -128,10 +158,10 @@ MpHash::lookup (MpType    type,
 
 //! If it is there the entry is deleted from the hash table. If it is not
 //! there, no action is taken. The match must be on type AND addr. The entry
-//! (MpEntry::) is itself deleted
+//! (MpEntry::) goes back to the pool.
 
-//! The usual fun and games tracking the previous entry, so we can delete
-//! things.
+//! The slot is marked deleted, rather than empty, so probes for entries
+//! beyond it still find them.
 
 //! @param[in]  type   The type of matchpoint
 //! @param[in]  addr   The address of the matchpoint
@@ -144,38 +174,167 @@ MpHash::remove (MpType    type,
 		uint32_t  addr,
 		uint32_t *instr)
 {
-  int      hv   = addr % size;
-  MpEntry *prev = NULL;
-  MpEntry *curr;
+  std::size_t  i = find (makeKey (type, addr));
+
+  if (i >= mSlots.size ())
+    return  false;			// Not found
+
+  if (NULL != instr)
+    *instr = mSlots[i].entry->instr;	// Return the found instruction
+
+  mFree.push_back (mSlots[i].entry);
+  mSlots[i].key   = DELETED_KEY;
+  mSlots[i].entry = NULL;
+  mLive--;
+
+  // Only clear the bit if there is no other breakpoint sharing it.
+  if (((BP_MEMORY == type) || (BP_HARDWARE == type))
+      && (NULL == lookup ((BP_MEMORY == type) ? BP_HARDWARE : BP_MEMORY,
+			  addr))
+      && !isBreak (addr ^ 1))
+    setBreakBit (addr, false);
+
+  return true;			// Success
+
+}	// remove ()
+
+
+//! Pack a type and address into a key
+
+//! The type is small, so a key is never one of the markers.
+
+//! @param[in] type   The type of matchpoint
+//! @param[in] addr   The address of the matchpoint
+//! @return  The key
+uint64_t
+MpHash::makeKey (MpType    type,
+		 uint32_t  addr)
+{
+  return  ((uint64_t) type << 32) | addr;
+
+}	// makeKey ()
+
+
+//! The slot a key hashes to
+
+//! This is Fibonacci hashing, which spreads the addresses of nearby
+//! breakpoints over the table.
+
+//! @param[in] key  The key
+//! @return  The index of the slot where a probe for the key starts
+std::size_t
+MpHash::home (uint64_t  key) const
+{
+  return  (std::size_t) ((key * 0x9e3779b97f4a7c15ULL) >> 32)
+    & (mSlots.size () - 1);
 
-  // Search
-  for (curr  = hashTab[hv]; NULL != curr; curr = curr->next)
+}	// home ()
+
+
+//! Find the slot holding a key
+
+//! Probe from the slot the key hashes to until we find it, or an empty
+//! slot.
+
+//! @param[in] key  The key to find
+//! @return  The index of the slot, or the size of the table if the key is
+//!          not there.
+std::size_t
+MpHash::find (uint64_t  key) const
+{
+  std::size_t  mask = mSlots.size () - 1;
+
+  for (std::size_t  i = home (key);
+       EMPTY_KEY != mSlots[i].key;
+       i = (i + 1) & mask)
+    if (key == mSlots[i].key)
+      return  i;
+
+  return  mSlots.size ();
+
+}	// find ()
+
+
+//! Rebuild the hash table
+
+//! All the live entries are put in a new table, which drops the deleted
+//! slots. The entries themselves do not move.
+
+//! @param[in] size  The new size of the table. A power of 2.
+void
+MpHash::rehash (std::size_t  size)
+{
+  std::vector<Slot>  old (size, Slot {EMPTY_KEY, NULL});
+  std::size_t        mask = size - 1;
+
+  old.swap (mSlots);
+
+  for (auto const &s : old)
+    if ((EMPTY_KEY != s.key) && (DELETED_KEY != s.key))
+      {
+	std::size_t  i;
+
+	for (i = home (s.key);
+	     EMPTY_KEY != mSlots[i].key;
+	     i = (i + 1) & mask)
+	  ;
+
+	mSlots[i] = s;
+      }
+
+  mUsed = mLive;
+
+}	// rehash ()
+
+
+//! Set or clear the bitmap bit for an address
+
+//! Pages of the bitmap are allocated as needed, and kept once allocated.
+
+//! @param[in] addr  The address.
+//! @param[in] val   TRUE to set the bit, FALSE to clear it.
+void
+MpHash::setBreakBit (uint32_t  addr,
+		     bool      val)
+{
+  Table *&t = mDir[addr >> (PAGE_BITS + TABLE_BITS)];
+
+  if (NULL == t)
     {
-      if ((type == curr->type) && (addr == curr->addr))
-	{
-	  // Found - delete. Method depends on whether we are the head of
-	  // chain.
-	  if (NULL == prev)
-	    {
-	      hashTab[hv] = curr->next;
-	    }
-	  else
-	    {
-	      prev->next = curr->next;
-	    }
-
-	  if (NULL != instr)
-	    {
-	      *instr = curr->instr;	// Return the found instruction
-	    }
-
-	  delete curr;
-	  return true;			// Success
-	}
-
-      prev = curr;
+      if (!val)
+	return;
+
+      t = new Table ();
     }
 
-  return  false;			// Not found
+  Page *&p = t->pages[(addr >> PAGE_BITS) & ((1 << TABLE_BITS) - 1)];
 
-}	// remove ()
+  if (NULL == p)
+    {
+      if (!val)
+	return;
+
+      p = new Page ();
+    }
+
+  uint64_t  bit = (uint64_t) 1 << ((addr >> 1) & 63);
+
+  if (val)
+    p->bits[(addr >> 7) & (PAGE_WORDS - 1)] |= bit;
+  else
+    p->bits[(addr >> 7) & (PAGE_WORDS - 1)] &= ~bit;
+
+}	// setBreakBit ()
+
+
+//! Is there a memory or hardware breakpoint at exactly this address?
+
+//! @param[in] addr  The address.
+//! @return  TRUE if there is.
+bool
+MpHash::isBreak (uint32_t  addr)
+{
+  return  (NULL != lookup (BP_MEMORY, addr))
+    || (NULL != lookup (BP_HARDWARE, addr));
+
+}	// isBreak ()
@@ -24,11 +24,14 @@
 #ifndef MP_HASH_H
 #define MP_HASH_H
 
+#include <cstddef>
+#include <deque>
 #include <stdint.h>
+#include <vector>
 
 
-//! Default size of the matchpoint hash table. Largest prime < 2^10
-#define DEFAULT_MP_HASH_SIZE  1021
+//! Default size of the matchpoint hash table. Rounded up to a power of 2.
+#define DEFAULT_MP_HASH_SIZE  1024
 
 
 //! Enumeration of different types of matchpoint.
@@ -44,30 +47,31 @@ enum MpType {
 };
 
 
-class MpHash;
-
 //! A structure for a matchpoint hash table entry
 struct MpEntry
 {
-public:
-
-  friend class MpHash;		// The only one which can get at next
-
   MpType    type;		//!< Type of matchpoint
   uint32_t  addr;		//!< Address with the matchpoint
   uint32_t  instr;		//!< Substituted instruction
-
-
-private:
-
-  MpEntry *next;		//!< Next in this slot
+  uint32_t  len;		//!< Length of the instruction in bytes
+  bool      inserted;		//!< Wanted in memory by GDB
+  bool      hwInserted;		//!< Wanted by GDB as hardware breakpoint
 };
 
 
 //! A hash table for matchpoints
 
-//! We do this as our own open hash table. Our keys are a pair of entities
-//! (address and type), so STL map is not trivial to use.
+//! We do this as our own open addressed hash table, with linear probing.
+//! Our keys are a pair of entities (address and type), which we pack into
+//! one 64-bit word held in the table, so a probe only compares that word.
+//! The entries themselves come from a pool, so an entry stays put while it
+//! is in the table, however the table grows.
+
+//! Alongside is a bitmap with one bit for each 2 byte instruction slot, set
+//! if there is a breakpoint (memory or hardware) there. This answers "is
+//! there a breakpoint at this PC?" without touching the table, so it is
+//! cheap enough to ask for every instruction. The bitmap is paged, with
+//! pages only allocated for addresses which have had a breakpoint.
 
 class MpHash
 {
@@ -78,23 +82,109 @@ public:
   ~MpHash ();
 
   // Accessor methods
-  void  add (MpType    type,
-	     uint32_t  addr,
-	     uint32_t  instr);
+  MpEntry *add (MpType    type,
+		uint32_t  addr,
+		uint32_t  instr);
   MpEntry *lookup (MpType    type,
 		   uint32_t  addr);
   bool  remove (MpType    type,
 		uint32_t  addr,
 		uint32_t *instr = NULL);
+  bool  breakAt (uint32_t  addr) const;
 
 private:
 
-  //! The hash table
-  MpEntry **hashTab;
+  //! One slot in the hash table
+  struct Slot
+  {
+    uint64_t  key;		//!< Packed type and address, or a marker
+    MpEntry  *entry;		//!< The entry, if the slot is in use
+  };
+
+  //! Key marking a slot which has never been used. Ends a probe.
+  static const uint64_t  EMPTY_KEY = UINT64_MAX;
+
+  //! Key marking a slot whose entry has been removed. A probe goes past it.
+  static const uint64_t  DELETED_KEY = UINT64_MAX - 1;
+
+  //! Address bits covered by one page of the bitmap
+  static const int  PAGE_BITS = 12;
+
+  //! Address bits covered by one table of pages
+  static const int  TABLE_BITS = 10;
+
+  //! Number of 64-bit words in one page of the bitmap, at one bit for each
+  //! 2 bytes.
+  static const int  PAGE_WORDS = (1 << PAGE_BITS) / 2 / 64;
+
+  //! One page of the bitmap
+  struct Page
+  {
+    uint64_t  bits[PAGE_WORDS];
+  };
+
+  //! One table of pages
+  struct Table
+  {
+    Page *pages[1 << TABLE_BITS];
+  };
 
-  //! Size of the hash table
-  int  size;
+  //! The hash table. Its size is a power of 2.
+  std::vector<Slot>  mSlots;
+
+  //! Number of slots in use, whether live or deleted
+  std::size_t  mUsed;
+
+  //! Number of live entries
+  std::size_t  mLive;
+
+  //! Where the entries come from. A deque, so they don't move as it grows.
+  std::deque<MpEntry>  mPool;
+
+  //! Entries in the pool free for reuse
+  std::vector<MpEntry *>  mFree;
+
+  //! The top level of the bitmap, one table for each part of the address
+  //! space.
+  Table *mDir[1 << (32 - PAGE_BITS - TABLE_BITS)];
+
+  // Internal helper methods
+  static uint64_t  makeKey (MpType    type,
+			    uint32_t  addr);
+  std::size_t  home (uint64_t  key) const;
+  std::size_t  find (uint64_t  key) const;
+  void  rehash (std::size_t  size);
+  void  setBreakBit (uint32_t  addr,
+		     bool      val);
+  bool  isBreak (uint32_t  addr);
 
 };
 
+
+//! Is there a breakpoint at an address?
+
+//! This only looks at the bitmap, so it is quick enough to call for every
+//! instruction executed, and is inline for that reason. Two addresses share
+//! each bit, but breakpoints are only ever at even addresses.
+
+//! @param[in] addr  The address to check.
+//! @return  TRUE if there is a memory or hardware breakpoint at the address.
+inline bool
+MpHash::breakAt (uint32_t  addr) const
+{
+  const Table *t = mDir[addr >> (PAGE_BITS + TABLE_BITS)];
+
+  if (NULL == t)
+    return  false;
+
+  const Page *p = t->pages[(addr >> PAGE_BITS) & ((1 << TABLE_BITS) - 1)];
+
+  if (NULL == p)
+    return  false;
+
+  return  ((p->bits[(addr >> 7) & (PAGE_WORDS - 1)] >> ((addr >> 1) & 63))
+	   & 1) != 0;
+
+}	// breakAt ()
+
 #endif	// MP_HASH_H
@@ -0,0 +1,307 @@
+// Matchpoint hash table: microbenchmark
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+// Times MpHash against the chained hash table the server used before, for
+// the two things the server does with it: checking whether there is a
+// breakpoint at the PC after every instruction, and GDB removing and
+// inserting all its breakpoints at every stop. The PC check is timed both
+// as a table lookup and with the bitmap. All give the same answers, or the
+// benchmark fails.
+
+// Usage: mp-hash-bench [<number of breakpoints>]
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <cstdlib>
+
+#include "MpHash.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::fixed;
+using std::left;
+using std::right;
+using std::setprecision;
+using std::setw;
+using std::vector;
+
+
+//! The number of PCs checked in each timed run
+
+static const std::size_t  NUM_PCS = 1 << 20;
+
+//! Size of the code the PCs and breakpoints are in
+
+static const uint32_t  CODE_SIZE = 256 * 1024;
+
+//! The number of times each function being timed is repeated
+
+static const int  REPS = 50;
+
+
+//! The chained hash table, as the server used to have it
+
+//! Each entry is allocated on insertion, and a lookup walks the chain for
+//! the address modulo a prime. The functions are not inlined, since in the
+//! server they were in their own source file, just as MpHash's are.
+
+class RefMpHash
+{
+public:
+
+  RefMpHash () :
+    hashTab (SIZE, nullptr)
+  {
+  }
+
+  ~RefMpHash ()
+  {
+    for (auto curr : hashTab)
+      while (nullptr != curr)
+	{
+	  Entry *next = curr->next;
+	  delete curr;
+	  curr = next;
+	}
+  }
+
+  void __attribute__ ((noinline))
+  add (MpType    type,
+       uint32_t  addr,
+       uint32_t  instr)
+  {
+    int  hv = addr % SIZE;
+
+    for (Entry *curr = hashTab[hv]; nullptr != curr; curr = curr->next)
+      if ((type == curr->type) && (addr == curr->addr))
+	return;
+
+    hashTab[hv] = new Entry { type, addr, instr, hashTab[hv] };
+  }
+
+  const void * __attribute__ ((noinline))
+  lookup (MpType    type,
+	  uint32_t  addr) const
+  {
+    for (Entry *curr = hashTab[addr % SIZE]; nullptr != curr;
+	 curr = curr->next)
+      if ((type == curr->type) && (addr == curr->addr))
+	return  curr;
+
+    return  nullptr;
+  }
+
+  bool __attribute__ ((noinline))
+  remove (MpType    type,
+	  uint32_t  addr)
+  {
+    for (Entry **prev = &hashTab[addr % SIZE]; nullptr != *prev;
+	 prev = &(*prev)->next)
+      if ((type == (*prev)->type) && (addr == (*prev)->addr))
+	{
+	  Entry *curr = *prev;
+
+	  *prev = curr->next;
+	  delete curr;
+	  return  true;
+	}
+
+    return  false;
+  }
+
+private:
+
+  static const int  SIZE = 1021;
+
+  struct Entry
+  {
+    MpType    type;
+    uint32_t  addr;
+    uint32_t  instr;
+    Entry    *next;
+  };
+
+  vector<Entry *>  hashTab;
+
+};	// RefMpHash
+
+
+//! Time a function, repeated REPS times
+
+//! @param[in] ops  The operations done by each call.
+//! @param[in] fn   The function to time.
+//! @return  The time per operation in ns.
+
+template <typename F>
+static double
+timeIt (std::size_t  ops,
+	F            fn)
+{
+  auto  start = std::chrono::steady_clock::now ();
+
+  for (int  r = 0; r < REPS; r++)
+    fn ();
+
+  std::chrono::duration<double>  secs =
+    std::chrono::steady_clock::now () - start;
+
+  return  secs.count () * 1.0e9 / (double) (ops * REPS);
+
+}	// timeIt ()
+
+
+//! Main program
+
+//! @param[in] argc  Number of arguments.
+//! @param[in] argv  The arguments. An optional number of breakpoints.
+//! @return  EXIT_SUCCESS if the tables agree, EXIT_FAILURE otherwise.
+
+int
+main (int   argc,
+      char *argv[])
+{
+  std::size_t  numBps = (argc > 1) ? strtoul (argv[1], nullptr, 0) : 50;
+
+  if ((0 == numBps) || (numBps > CODE_SIZE / 4))
+    {
+      cerr << "Usage: mp-hash-bench [<number of breakpoints>]" << endl;
+      return  EXIT_FAILURE;
+    }
+
+  // Breakpoints at distinct instructions, and PCs which mostly run
+  // straight on, with a branch now and again.
+  std::mt19937      gen (42);
+  vector<uint32_t>  bps;
+  vector<uint32_t>  pcs (NUM_PCS);
+  vector<bool>      used (CODE_SIZE / 4, false);
+
+  while (bps.size () < numBps)
+    {
+      uint32_t  slot = gen () % (CODE_SIZE / 4);
+
+      if (!used[slot])
+	{
+	  used[slot] = true;
+	  bps.push_back (slot * 4);
+	}
+    }
+
+  uint32_t  pc = 0;
+
+  for (auto &p : pcs)
+    {
+      pc = ((gen () & 0xf) == 0) ? (gen () % CODE_SIZE) & ~3 : pc + 4;
+      pc %= CODE_SIZE;
+      p = pc;
+    }
+
+  RefMpHash  ref;
+  MpHash     mp;
+
+  for (auto a : bps)
+    {
+      ref.add (BP_MEMORY, a, 0);
+      mp.add (BP_MEMORY, a, 0);
+    }
+
+  // Check they agree.
+  std::size_t  refHits  = 0;
+  std::size_t  hashHits = 0;
+  std::size_t  bitHits  = 0;
+
+  for (auto p : pcs)
+    {
+      refHits  += (nullptr != ref.lookup (BP_MEMORY, p)) ? 1 : 0;
+      hashHits += (nullptr != mp.lookup (BP_MEMORY, p)) ? 1 : 0;
+      bitHits  += mp.breakAt (p) ? 1 : 0;
+    }
+
+  if ((refHits != hashHits) || (refHits != bitHits))
+    {
+      cerr << "ERROR: PC checks disagree: " << refHits << " chained, "
+	   << hashHits << " open addressed, " << bitHits << " bitmap" << endl;
+      return  EXIT_FAILURE;
+    }
+
+  volatile std::size_t  sink = 0;
+
+  cout << numBps << " breakpoints, " << refHits << " hits in " << NUM_PCS
+       << " PCs, results in ns per operation" << endl;
+  cout << left << setw (24) << "Table" << right << setw (12) << "PC check"
+       << setw (12) << "z0 + Z0" << endl;
+
+  // The PC check, as a run loop would do it.
+  double  refPc = timeIt (NUM_PCS, [&] {
+      std::size_t  n = 0;
+      for (auto p : pcs)
+	n += (nullptr != ref.lookup (BP_MEMORY, p)) ? 1 : 0;
+      sink = n; });
+  double  hashPc = timeIt (NUM_PCS, [&] {
+      std::size_t  n = 0;
+      for (auto p : pcs)
+	n += (nullptr != mp.lookup (BP_MEMORY, p)) ? 1 : 0;
+      sink = n; });
+  double  bitPc = timeIt (NUM_PCS, [&] {
+      std::size_t  n = 0;
+      for (auto p : pcs)
+	n += mp.breakAt (p) ? 1 : 0;
+      sink = n; });
+
+  // GDB removing and inserting all its breakpoints at a stop.
+  double  refChurn = timeIt (numBps * 1000, [&] {
+      for (int  i = 0; i < 1000; i++)
+	{
+	  for (auto a : bps)
+	    ref.remove (BP_MEMORY, a);
+	  for (auto a : bps)
+	    ref.add (BP_MEMORY, a, 0);
+	} });
+  double  hashChurn = timeIt (numBps * 1000, [&] {
+      for (int  i = 0; i < 1000; i++)
+	{
+	  for (auto a : bps)
+	    mp.remove (BP_MEMORY, a);
+	  for (auto a : bps)
+	    mp.add (BP_MEMORY, a, 0);
+	} });
+
+  cout << fixed << setprecision (2)
+       << left << setw (24) << "chained" << right << setw (12) << refPc
+       << setw (12) << refChurn << endl
+       << left << setw (24) << "open addressed" << right << setw (12)
+       << hashPc << setw (12) << hashChurn << endl
+       << left << setw (24) << "open addressed + bitmap" << right
+       << setw (12) << bitPc << setw (12) << "-" << endl;
+
+  (void) sink;
+  return  EXIT_SUCCESS;
+
+}	// main ()
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
@@ -0,0 +1,274 @@
+// RSP packet statistics: implementation
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#include <iomanip>
+
+#include <cmath>
+#include <cstring>
+
+#include "PacketStats.h"
+
+using std::endl;
+using std::fixed;
+using std::left;
+using std::right;
+using std::setprecision;
+using std::setw;
+using std::string;
+
+
+//! Constructor for a histogram
+
+PacketStats::Histogram::Histogram () :
+  mCount (0),
+  mMax (0)
+{
+  memset (mBuckets, 0, sizeof (mBuckets));
+
+}	// Histogram ()
+
+
+//! Record a value in a histogram
+
+//! @param[in] ns  The value to record, in nanoseconds.
+
+void
+PacketStats::Histogram::record (uint64_t  ns)
+{
+  mBuckets[bucket (ns)]++;
+  mCount++;
+
+  if (ns > mMax)
+    mMax = ns;
+
+}	// record ()
+
+
+//! Get a percentile from a histogram
+
+//! @param[in] pc  The percentile wanted (0 to 100).
+//! @return  The largest value which could be in the bucket holding that
+//!          percentile, or zero if nothing has been recorded.
+
+uint64_t
+PacketStats::Histogram::percentile (double  pc) const
+{
+  uint64_t  target = (uint64_t) ceil (pc / 100.0 * (double) mCount);
+  uint64_t  seen   = 0;
+
+  if (0 == target)
+    target = 1;
+
+  for (int  b = 0; b < NUM_BUCKETS; b++)
+    {
+      seen += mBuckets[b];
+
+      if (seen >= target)
+	{
+	  uint64_t  top = bucketTop (b);
+
+	  return  top < mMax ? top : mMax;
+	}
+    }
+
+  return  mMax;
+
+}	// percentile ()
+
+
+//! Get the largest value recorded in a histogram
+
+//! @return  The largest value, in nanoseconds.
+
+uint64_t
+PacketStats::Histogram::max () const
+{
+  return  mMax;
+
+}	// max ()
+
+
+//! Which bucket does a value belong in?
+
+//! @param[in] ns  The value.
+//! @return  The bucket number.
+
+int
+PacketStats::Histogram::bucket (uint64_t  ns)
+{
+  if (ns < SUB_BUCKETS)
+    return  (int) ns;
+
+  int  msb   = 63 - __builtin_clzll (ns);
+  int  shift = msb - SUB_BITS;
+
+  return  (shift + 1) * SUB_BUCKETS
+    + (int) ((ns >> shift) & (SUB_BUCKETS - 1));
+
+}	// bucket ()
+
+
+//! What is the largest value in a bucket?
+
+//! @param[in] b  The bucket number.
+//! @return  The largest value which would be put in that bucket.
+
+uint64_t
+PacketStats::Histogram::bucketTop (int  b)
+{
+  if (b < SUB_BUCKETS)
+    return  (uint64_t) b;
+
+  int       shift = b / SUB_BUCKETS - 1;
+  uint64_t  low   = (uint64_t) (SUB_BUCKETS + b % SUB_BUCKETS) << shift;
+
+  return  low + ((uint64_t) 1 << shift) - 1;
+
+}	// bucketTop ()
+
+
+//! Constructor
+
+PacketStats::PacketStats ()
+{
+  // Nothing.
+
+}	// PacketStats ()
+
+
+//! Destructor
+
+PacketStats::~PacketStats ()
+{
+  // Nothing.
+
+}	// ~PacketStats ()
+
+
+//! Record one packet
+
+//! @param[in] name        The group of the packet, from name ().
+//! @param[in] bytesIn     Payload bytes in the packet.
+//! @param[in] bytesOut    Payload bytes in all the replies.
+//! @param[in] queueTime   Time from decode until the server took it.
+//! @param[in] targetTime  Time handling it, other than I/O.
+//! @param[in] ioTime      Time sending the replies.
+
+void
+PacketStats::record (const string    &name,
+		     std::size_t      bytesIn,
+		     std::size_t      bytesOut,
+		     Clock::duration  queueTime,
+		     Clock::duration  targetTime,
+		     Clock::duration  ioTime)
+{
+  Entry &e = mEntries[name];		// Value initialized if new
+
+  e.count++;
+  e.bytesIn    += bytesIn;
+  e.bytesOut   += bytesOut;
+  e.queueTime  += queueTime;
+  e.targetTime += targetTime;
+  e.ioTime     += ioTime;
+
+  Clock::duration  total = queueTime + targetTime + ioTime;
+
+  e.latency.record (std::chrono::duration_cast<std::chrono::nanoseconds>
+		    (total).count ());
+
+}	// record ()
+
+
+//! Report all the statistics
+
+//! One line per group of packets. Percentiles and max are of the total
+//! latency. Queue, target and I/O times are the mean for each packet. All
+//! times are in microseconds.
+
+//! @param[in] s  The stream for the report.
+
+void
+PacketStats::report (std::ostream &s) const
+{
+  s << left << setw (18) << "Packet" << right
+    << setw (8) << "Count" << setw (10) << "Bytes in" << setw (10)
+    << "Bytes out" << setw (9) << "p50 us" << setw (9) << "p90 us"
+    << setw (9) << "p99 us" << setw (9) << "Max us" << setw (9)
+    << "Queue us" << setw (10) << "Target us" << setw (9) << "I/O us" << endl;
+
+  for (auto const &it : mEntries)
+    {
+      const Entry &e = it.second;
+      double  n = (double) e.count;
+
+      s << left << setw (18) << it.first << right << fixed
+	<< setprecision (1) << setw (8) << e.count << setw (10) << e.bytesIn
+	<< setw (10) << e.bytesOut
+	<< setw (9) << e.latency.percentile (50.0) / 1.0e3
+	<< setw (9) << e.latency.percentile (90.0) / 1.0e3
+	<< setw (9) << e.latency.percentile (99.0) / 1.0e3
+	<< setw (9) << e.latency.max () / 1.0e3
+	<< setw (9) << std::chrono::duration<double, std::micro>
+	  (e.queueTime).count () / n
+	<< setw (10) << std::chrono::duration<double, std::micro>
+	  (e.targetTime).count () / n
+	<< setw (9) << std::chrono::duration<double, std::micro>
+	  (e.ioTime).count () / n << endl;
+    }
+}	// report ()
+
+
+//! Work out which group a packet belongs to
+
+//! The command letter, or for q, Q and v packets the name up to the first
+//! separator.
+
+//! @param[in] data  The packet.
+//! @param[in] len   The length of the packet.
+//! @return  The name of the group.
+
+string
+PacketStats::name (const char *data,
+		   int         len)
+{
+  //! Longest name we keep, in case of garbage.
+  static const int  MAX_NAME = 24;
+
+  if (len <= 0)
+    return  string ("(empty)");
+
+  if (('q' != data[0]) && ('Q' != data[0]) && ('v' != data[0]))
+    return  string (1, data[0]);
+
+  int  n;
+
+  for (n = 1; (n < len) && (n < MAX_NAME); n++)
+    if ((':' == data[n]) || (',' == data[n]) || (';' == data[n]))
+      break;
+
+  return  string (data, n);
+
+}	// name ()
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
@@ -0,0 +1,151 @@
+// RSP packet statistics: declaration
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PACKET_STATS_H
+#define PACKET_STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+
+
+//! Statistics for the RSP packets handled by a server
+
+//! Packets are grouped by command letter, except that q, Q and v packets
+//! are grouped by their full name (for example "qSupported" or "vCont").
+//! For each group we keep counts, payload bytes in and out, and a histogram
+//! of the total latency, from the packet being decoded by the connection to
+//! the last reply being sent.
+
+//! That latency is split three ways, so a slow session can be blamed on the
+//! right party:
+//! - queue time, from the packet being decoded to the server taking it;
+//! - I/O time, sending replies and waiting for their acks;
+//! - target time, everything else while handling the packet. This is
+//!   dominated by the calls to the target, although it includes the
+//!   (small) time the server takes to decode and encode packets.
+
+class PacketStats
+{
+public:
+
+  //! The clock we use for all timing
+
+  typedef std::chrono::steady_clock  Clock;
+
+  // Constructor and destructor
+
+  PacketStats ();
+  ~PacketStats ();
+
+  // Record one packet
+
+  void  record (const std::string &name,
+		std::size_t         bytesIn,
+		std::size_t         bytesOut,
+		Clock::duration     queueTime,
+		Clock::duration     targetTime,
+		Clock::duration     ioTime);
+
+  // Report all the statistics
+
+  void  report (std::ostream &s) const;
+
+  // Work out which group a packet belongs to
+
+  static std::string  name (const char *data,
+			    int         len);
+
+private:
+
+  //! HDR style latency histogram
+
+  //! Values (in nanoseconds) below SUB_BUCKETS are counted exactly. Above
+  //! that each power of 2 is split into SUB_BUCKETS buckets, so a value is
+  //! never reported with an error of more than 1 part in SUB_BUCKETS,
+  //! however large it is.
+
+  class Histogram
+  {
+  public:
+
+    Histogram ();
+
+    void      record (uint64_t  ns);
+    uint64_t  percentile (double  pc) const;
+    uint64_t  max () const;
+
+  private:
+
+    //! Number of bits used to pick the sub-bucket within a power of 2
+
+    static const int  SUB_BITS = 4;
+
+    //! Number of sub-buckets for each power of 2
+
+    static const int  SUB_BUCKETS = 1 << SUB_BITS;
+
+    //! Total buckets, enough for any 64-bit value
+
+    static const int  NUM_BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    //! Count of values in each bucket
+
+    uint64_t  mBuckets[NUM_BUCKETS];
+
+    //! Total number of values
+
+    uint64_t  mCount;
+
+    //! Largest value recorded
+
+    uint64_t  mMax;
+
+    static int       bucket (uint64_t  ns);
+    static uint64_t  bucketTop (int  b);
+  };
+
+  //! Everything we know about one group of packets
+
+  struct Entry
+  {
+    uint64_t         count;
+    uint64_t         bytesIn;
+    uint64_t         bytesOut;
+    Clock::duration  queueTime;
+    Clock::duration  targetTime;
+    Clock::duration  ioTime;
+    Histogram        latency;
+  };
+
+  //! All the groups seen so far, sorted by name for reporting
+
+  std::map<std::string, Entry>  mEntries;
+
+};	// PacketStats ()
+
+#endif	// PACKET_STATS_H
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
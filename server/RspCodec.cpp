@@ -0,0 +1,771 @@
+// RSP frame encoding and decoding kernels: implementation
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#include <cstring>
+
+#include "RspCodec.h"
+
+#if defined (__x86_64__) || defined (__i386__)
+#define RSP_CODEC_X86 1
+#include <immintrin.h>
+#endif
+
+
+// ----------------------------------------------------------------------------
+// The scalar kernel. Always available.
+// ----------------------------------------------------------------------------
+
+//! Sum all the chars in a buffer, a char at a time
+
+//! @param[in] buf  The buffer.
+//! @param[in] len  Its length.
+//! @return  The sum of all the chars, as unsigned values.
+
+static uint64_t
+sumScalar (const char  *buf,
+	   std::size_t  len)
+{
+  uint64_t  sum = 0;
+
+  for (std::size_t  i = 0; i < len; i++)
+    sum += (unsigned char) buf[i];
+
+  return  sum;
+
+}	// sumScalar ()
+
+
+//! Find the first of any of four chars in a buffer, a char at a time
+
+//! @param[in] buf  The buffer.
+//! @param[in] len  Its length.
+//! @param[in] c0   The first char to look for.
+//! @param[in] c1   The second char to look for.
+//! @param[in] c2   The third char to look for.
+//! @param[in] c3   The fourth char to look for.
+//! @return  The offset of the first matching char, or len if there is none.
+
+static std::size_t
+find4Scalar (const char  *buf,
+	     std::size_t  len,
+	     char         c0,
+	     char         c1,
+	     char         c2,
+	     char         c3)
+{
+  for (std::size_t  i = 0; i < len; i++)
+    {
+      char  ch = buf[i];
+
+      if ((c0 == ch) || (c1 == ch) || (c2 == ch) || (c3 == ch))
+	return  i;
+    }
+
+  return  len;
+
+}	// find4Scalar ()
+
+
+//! Find the first run of 4 identical chars in a buffer, a char at a time
+
+//! @param[in] buf  The buffer.
+//! @param[in] len  Its length.
+//! @return  The offset of the start of the first run, or len if there is
+//!          none.
+
+static std::size_t
+findRunScalar (const char  *buf,
+	       std::size_t  len)
+{
+  for (std::size_t  i = 0; i + 3 < len; i++)
+    {
+      char  ch = buf[i];
+
+      if ((buf[i + 1] == ch) && (buf[i + 2] == ch) && (buf[i + 3] == ch))
+	return  i;
+    }
+
+  return  len;
+
+}	// findRunScalar ()
+
+
+#ifdef RSP_CODEC_X86
+
+// ----------------------------------------------------------------------------
+// The SSE2 kernel. 16 chars at a time.
+// ----------------------------------------------------------------------------
+
+//! Sum all the chars in a buffer, 16 at a time
+
+//! PSADBW against zero sums each group of 8 bytes into a 64-bit lane, so
+//! the lanes cannot overflow for any buffer we could hold.
+
+//! @param[in] buf  The buffer.
+//! @param[in] len  Its length.
+//! @return  The sum of all the chars, as unsigned values.
+
+__attribute__ ((target ("sse2")))
+static uint64_t
+sumSse2 (const char  *buf,
+	 std::size_t  len)
+{
+  const __m128i  zero = _mm_setzero_si128 ();
+  __m128i        acc  = zero;
+  std::size_t    i    = 0;
+
+  for (; i + 16 <= len; i += 16)
+    {
+      __m128i  v = _mm_loadu_si128 ((const __m128i *) (buf + i));
+      acc = _mm_add_epi64 (acc, _mm_sad_epu8 (v, zero));
+    }
+
+  uint64_t  lanes[2];
+  _mm_storeu_si128 ((__m128i *) lanes, acc);
+
+  return  lanes[0] + lanes[1] + sumScalar (buf + i, len - i);
+
+}	// sumSse2 ()
+
+
+//! Find the first of any of four chars in a buffer, 16 at a time
+
+//! @param[in] buf  The buffer.
+//! @param[in] len  Its length.
+//! @param[in] c0   The first char to look for.
+//! @param[in] c1   The second char to look for.
+//! @param[in] c2   The third char to look for.
+//! @param[in] c3   The fourth char to look for.
+//! @return  The offset of the first matching char, or len if there is none.
+
+__attribute__ ((target ("sse2")))
+static std::size_t
+find4Sse2 (const char  *buf,
+	   std::size_t  len,
+	   char         c0,
+	   char         c1,
+	   char         c2,
+	   char         c3)
+{
+  const __m128i  v0 = _mm_set1_epi8 (c0);
+  const __m128i  v1 = _mm_set1_epi8 (c1);
+  const __m128i  v2 = _mm_set1_epi8 (c2);
+  const __m128i  v3 = _mm_set1_epi8 (c3);
+  std::size_t    i  = 0;
+
+  for (; i + 16 <= len; i += 16)
+    {
+      __m128i  v = _mm_loadu_si128 ((const __m128i *) (buf + i));
+      __m128i  m = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, v0),
+					       _mm_cmpeq_epi8 (v, v1)),
+				 _mm_or_si128 (_mm_cmpeq_epi8 (v, v2),
+					       _mm_cmpeq_epi8 (v, v3)));
+      int  mask = _mm_movemask_epi8 (m);
+
+      if (0 != mask)
+	return  i + __builtin_ctz (mask);
+    }
+
+  return  i + find4Scalar (buf + i, len - i, c0, c1, c2, c3);
+
+}	// find4Sse2 ()
+
+
+//! Find the first run of 4 identical chars in a buffer, 16 at a time
+
+//! Each char is compared with the three which follow it, using unaligned
+//! loads at offsets 1, 2 and 3.
+
+//! @param[in] buf  The buffer.
+//! @param[in] len  Its length.
+//! @return  The offset of the start of the first run, or len if there is
+//!          none.
+
+__attribute__ ((target ("sse2")))
+static std::size_t
+findRunSse2 (const char  *buf,
+	     std::size_t  len)
+{
+  std::size_t  i = 0;
+
+  for (; i + 16 + 3 <= len; i += 16)
+    {
+      const char *p  = buf + i;
+      __m128i     v0 = _mm_loadu_si128 ((const __m128i *) p);
+      __m128i     v1 = _mm_loadu_si128 ((const __m128i *) (p + 1));
+      __m128i     v2 = _mm_loadu_si128 ((const __m128i *) (p + 2));
+      __m128i     v3 = _mm_loadu_si128 ((const __m128i *) (p + 3));
+      __m128i     m  = _mm_and_si128 (_mm_and_si128 (_mm_cmpeq_epi8 (v0, v1),
+						     _mm_cmpeq_epi8 (v0, v2)),
+				      _mm_cmpeq_epi8 (v0, v3));
+      int  mask = _mm_movemask_epi8 (m);
+
+      if (0 != mask)
+	return  i + __builtin_ctz (mask);
+    }
+
+  return  i + findRunScalar (buf + i, len - i);
+
+}	// findRunSse2 ()
+
+
+// ----------------------------------------------------------------------------
+// The AVX2 kernel. 32 chars at a time.
+// ----------------------------------------------------------------------------
+
+//! Sum all the chars in a buffer, 32 at a time
+
+//! As for sumSse2 (), with SSE2 finishing off any tail.
+
+//! @param[in] buf  The buffer.
+//! @param[in] len  Its length.
+//! @return  The sum of all the chars, as unsigned values.
+
+__attribute__ ((target ("avx2")))
+static uint64_t
+sumAvx2 (const char  *buf,
+	 std::size_t  len)
+{
+  const __m256i  zero = _mm256_setzero_si256 ();
+  __m256i        acc  = zero;
+  std::size_t    i    = 0;
+
+  for (; i + 32 <= len; i += 32)
+    {
+      __m256i  v = _mm256_loadu_si256 ((const __m256i *) (buf + i));
+      acc = _mm256_add_epi64 (acc, _mm256_sad_epu8 (v, zero));
+    }
+
+  uint64_t  lanes[4];
+  _mm256_storeu_si256 ((__m256i *) lanes, acc);
+  _mm256_zeroupper ();			// Tail may use legacy SSE
+
+  return  lanes[0] + lanes[1] + lanes[2] + lanes[3]
+    + sumSse2 (buf + i, len - i);
+
+}	// sumAvx2 ()
+
+
+//! Find the first of any of four chars in a buffer, 32 at a time
+
+//! @param[in] buf  The buffer.
+//! @param[in] len  Its length.
+//! @param[in] c0   The first char to look for.
+//! @param[in] c1   The second char to look for.
+//! @param[in] c2   The third char to look for.
+//! @param[in] c3   The fourth char to look for.
+//! @return  The offset of the first matching char, or len if there is none.
+
+__attribute__ ((target ("avx2")))
+static std::size_t
+find4Avx2 (const char  *buf,
+	   std::size_t  len,
+	   char         c0,
+	   char         c1,
+	   char         c2,
+	   char         c3)
+{
+  const __m256i  v0 = _mm256_set1_epi8 (c0);
+  const __m256i  v1 = _mm256_set1_epi8 (c1);
+  const __m256i  v2 = _mm256_set1_epi8 (c2);
+  const __m256i  v3 = _mm256_set1_epi8 (c3);
+  std::size_t    i  = 0;
+
+  for (; i + 32 <= len; i += 32)
+    {
+      __m256i  v = _mm256_loadu_si256 ((const __m256i *) (buf + i));
+      __m256i  m =
+	_mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (v, v0),
+					  _mm256_cmpeq_epi8 (v, v1)),
+			 _mm256_or_si256 (_mm256_cmpeq_epi8 (v, v2),
+					  _mm256_cmpeq_epi8 (v, v3)));
+      unsigned int  mask = (unsigned int) _mm256_movemask_epi8 (m);
+
+      if (0 != mask)
+	return  i + __builtin_ctz (mask);
+    }
+
+  // Let SSE2 mop up the last 16 if there are that many. Mixing dirty AVX
+  // state with legacy SSE code is very slow, so clear it first.
+  _mm256_zeroupper ();
+  return  i + find4Sse2 (buf + i, len - i, c0, c1, c2, c3);
+
+}	// find4Avx2 ()
+
+
+//! Find the first run of 4 identical chars in a buffer, 32 at a time
+
+//! @param[in] buf  The buffer.
+//! @param[in] len  Its length.
+//! @return  The offset of the start of the first run, or len if there is
+//!          none.
+
+__attribute__ ((target ("avx2")))
+static std::size_t
+findRunAvx2 (const char  *buf,
+	     std::size_t  len)
+{
+  std::size_t  i = 0;
+
+  for (; i + 32 + 3 <= len; i += 32)
+    {
+      const char *p  = buf + i;
+      __m256i     v0 = _mm256_loadu_si256 ((const __m256i *) p);
+      __m256i     v1 = _mm256_loadu_si256 ((const __m256i *) (p + 1));
+      __m256i     v2 = _mm256_loadu_si256 ((const __m256i *) (p + 2));
+      __m256i     v3 = _mm256_loadu_si256 ((const __m256i *) (p + 3));
+      __m256i     m  =
+	_mm256_and_si256 (_mm256_and_si256 (_mm256_cmpeq_epi8 (v0, v1),
+					    _mm256_cmpeq_epi8 (v0, v2)),
+			  _mm256_cmpeq_epi8 (v0, v3));
+      unsigned int  mask = (unsigned int) _mm256_movemask_epi8 (m);
+
+      if (0 != mask)
+	return  i + __builtin_ctz (mask);
+    }
+
+  _mm256_zeroupper ();			// Tail may use legacy SSE
+  return  i + findRunSse2 (buf + i, len - i);
+
+}	// findRunAvx2 ()
+
+#endif	// RSP_CODEC_X86
+
+
+// ----------------------------------------------------------------------------
+// Kernel selection
+// ----------------------------------------------------------------------------
+
+//! Look up the functions for a kernel
+
+//! @param[in] k  The kernel wanted.
+//! @return  The functions for the kernel, or nullptr if it is not built in,
+//!          or the CPU does not support it.
+
+const RspCodec::Kernels *
+RspCodec::lookup (Kernel  k)
+{
+  static_assert (4 == MIN_RUN, "findRun kernels assume runs of 4");
+
+  static const Kernels  scalar = { Kernel::SCALAR, sumScalar, find4Scalar,
+				   findRunScalar };
+#ifdef RSP_CODEC_X86
+  static const Kernels  sse2   = { Kernel::SSE2, sumSse2, find4Sse2,
+				   findRunSse2 };
+  static const Kernels  avx2   = { Kernel::AVX2, sumAvx2, find4Avx2,
+				   findRunAvx2 };
+#endif
+
+  switch (k)
+    {
+    case Kernel::SCALAR:
+      return  &scalar;
+
+#ifdef RSP_CODEC_X86
+    case Kernel::SSE2:
+      __builtin_cpu_init ();
+      return  __builtin_cpu_supports ("sse2") ? &sse2 : nullptr;
+
+    case Kernel::AVX2:
+      __builtin_cpu_init ();
+      return  __builtin_cpu_supports ("avx2") ? &avx2 : nullptr;
+#endif
+
+    default:
+      return  nullptr;
+    }
+}	// lookup ()
+
+
+//! Which is the fastest kernel this CPU supports?
+
+//! @return  The kernel.
+
+RspCodec::Kernel
+RspCodec::bestKernel ()
+{
+  if (nullptr != lookup (Kernel::AVX2))
+    return  Kernel::AVX2;
+  else if (nullptr != lookup (Kernel::SSE2))
+    return  Kernel::SSE2;
+  else
+    return  Kernel::SCALAR;
+
+}	// bestKernel ()
+
+
+//! The kernel in use, chosen when the program starts.
+
+const RspCodec::Kernels *RspCodec::sKernels =
+  RspCodec::lookup (RspCodec::bestKernel ());
+
+
+//! Choose the kernel to use
+
+//! Only intended for testing and benchmarking. Must not be called while
+//! any other thread is framing packets.
+
+//! @param[in] k  The kernel wanted.
+//! @return  TRUE if the kernel is now in use, FALSE if it is not supported,
+//!          in which case the kernel is unchanged.
+
+bool
+RspCodec::setKernel (Kernel  k)
+{
+  const Kernels *kernels = lookup (k);
+
+  if (nullptr == kernels)
+    return  false;
+
+  sKernels = kernels;
+  return  true;
+
+}	// setKernel ()
+
+
+//! Which kernel is in use?
+
+//! @return  The kernel.
+
+RspCodec::Kernel
+RspCodec::kernel ()
+{
+  return  sKernels->kernel;
+
+}	// kernel ()
+
+
+//! The name of a kernel
+
+//! @param[in] k  The kernel.
+//! @return  Its name, for reporting.
+
+const char *
+RspCodec::kernelName (Kernel  k)
+{
+  switch (k)
+    {
+    case Kernel::SCALAR: return  "scalar";
+    case Kernel::SSE2:   return  "sse2";
+    case Kernel::AVX2:   return  "avx2";
+    default:             return  "unknown";
+    }
+}	// kernelName ()
+
+
+// ----------------------------------------------------------------------------
+// Whole buffer operations
+// ----------------------------------------------------------------------------
+
+//! The RSP checksum of a buffer
+
+//! @param[in] buf  The buffer.
+//! @param[in] len  Its length.
+//! @return  The sum of all the chars, modulo 256.
+
+uint8_t
+RspCodec::checksum (const char  *buf,
+		    std::size_t  len)
+{
+  if (len < SHORT_LEN)
+    return  (uint8_t) sumScalar (buf, len);
+  else
+    return  (uint8_t) sKernels->sum (buf, len);
+
+}	// checksum ()
+
+
+//! Find the first char which must be escaped
+
+//! '$', '#', '*' and '}' must be escaped in a packet body.
+
+//! @param[in] buf  The buffer.
+//! @param[in] len  Its length.
+//! @return  The offset of the first such char, or len if there is none.
+
+std::size_t
+RspCodec::findSpecial (const char  *buf,
+		       std::size_t  len)
+{
+  return  sKernels->find4 (buf, len, '$', '#', '*', '}');
+
+}	// findSpecial ()
+
+
+//! Find the end of a packet body
+
+//! A packet body is ended by '#', or abandoned by a new '$'.
+
+//! @param[in] buf  The buffer.
+//! @param[in] len  Its length.
+//! @return  The offset of the first '$' or '#', or len if there is none.
+
+std::size_t
+RspCodec::findFrameEnd (const char  *buf,
+			std::size_t  len)
+{
+  return  sKernels->find4 (buf, len, '$', '#', '$', '#');
+
+}	// findFrameEnd ()
+
+
+//! Find the first run of chars worth run length encoding
+
+//! @param[in] buf  The buffer.
+//! @param[in] len  Its length.
+//! @return  The offset of the first run of at least MIN_RUN identical chars,
+//!          or len if there is none.
+
+std::size_t
+RspCodec::findRepeat (const char  *buf,
+		      std::size_t  len)
+{
+  return  sKernels->findRun (buf, len);
+
+}	// findRepeat ()
+
+
+//! Escape a packet body, and add it to a checksum
+
+//! '$', '#', '*' and '}' are escaped by preceding them with '}' and then
+//! XORing the character with 0x20. Runs of other chars are copied as a
+//! block. Short bodies are done a char at a time, since they are not worth
+//! setting up the kernel for.
+
+//! @param[in]     src   The packet body.
+//! @param[in]     len   Its length.
+//! @param[out]    dest  Where to put the escaped body. Must have room for
+//!                      2 * len chars.
+//! @param[in,out] csum  The checksum, to which the escaped body is added.
+//! @return  The length of the escaped body.
+
+std::size_t
+RspCodec::escape (const char  *src,
+		  std::size_t  len,
+		  char        *dest,
+		  uint8_t     &csum)
+{
+  uint64_t     sum = csum;
+  std::size_t  out = 0;
+  std::size_t  in  = 0;
+
+  if (len < SHORT_LEN)
+    {
+      for (; in < len; in++)
+	{
+	  char  ch = src[in];
+
+	  if (('$' == ch) || ('#' == ch) || ('*' == ch) || ('}' == ch))
+	    {
+	      ch ^= 0x20;
+	      sum += (unsigned char) '}';
+	      dest[out++] = '}';
+	    }
+
+	  sum += (unsigned char) ch;
+	  dest[out++] = ch;
+	}
+
+      csum = (uint8_t) sum;
+      return  out;
+    }
+
+  while (in < len)
+    {
+      std::size_t  run = findSpecial (src + in, len - in);
+
+      memcpy (dest + out, src + in, run);
+      sum += sKernels->sum (src + in, run);
+      in  += run;
+      out += run;
+
+      if (in < len)
+	{
+	  char  ch = src[in++] ^ 0x20;
+
+	  dest[out++] = '}';
+	  dest[out++] = ch;
+	  sum += (unsigned char) '}' + (unsigned char) ch;
+	}
+    }
+
+  csum = (uint8_t) sum;
+  return  out;
+
+}	// escape ()
+
+
+//! Escape and run length encode a packet body, and add it to a checksum
+
+//! Chars are escaped as for escape (). In addition a run of at least MIN_RUN
+//! identical chars is sent as the char, '*' and a printable repeat count
+//! (the number of repeats + 29). As the RSP requires, no count may be '$' or
+//! '#', so runs which would need them are shortened. Chars which must be
+//! escaped are never run length encoded.
+
+//! Only the server may run length encode, so this is only for replies.
+
+//! @param[in]     src   The packet body.
+//! @param[in]     len   Its length.
+//! @param[out]    dest  Where to put the encoded body. Must have room for
+//!                      2 * len chars.
+//! @param[in,out] csum  The checksum, to which the encoded body is added.
+//! @return  The length of the encoded body.
+
+std::size_t
+RspCodec::encode (const char  *src,
+		  std::size_t  len,
+		  char        *dest,
+		  uint8_t     &csum)
+{
+  if (len < SHORT_LEN)
+    return  escape (src, len, dest, csum);
+
+  uint64_t     sum     = csum;
+  std::size_t  out     = 0;
+  std::size_t  in      = 0;
+  std::size_t  special = 0;		// Next char to escape
+  std::size_t  repeat  = 0;		// Next run to encode
+
+  // The next special char and next run are only searched for again once
+  // we have passed them.
+  special = findSpecial (src, len);
+  repeat  = findRepeat (src, len);
+
+  while (in < len)
+    {
+      if (special < in)
+	special = in + findSpecial (src + in, len - in);
+
+      if (repeat < in)
+	repeat = in + findRepeat (src + in, len - in);
+
+      // Copy everything up to whichever comes first
+      std::size_t  stop = (special < repeat) ? special : repeat;
+      std::size_t  run  = stop - in;
+
+      memcpy (dest + out, src + in, run);
+      sum += sKernels->sum (src + in, run);
+      in  += run;
+      out += run;
+
+      if (in >= len)
+	break;
+
+      char  ch = src[in];
+
+      if (in == special)
+	{
+	  // Escaped chars are never run length encoded.
+	  ch ^= 0x20;
+	  dest[out++] = '}';
+	  dest[out++] = ch;
+	  sum += (unsigned char) '}' + (unsigned char) ch;
+	  in++;
+	}
+      else
+	{
+	  // A run. Work out its length, 8 chars at a time while we can, and
+	  // avoid counts of '$' and '#'.
+	  std::size_t  n = MIN_RUN;
+	  uint64_t     pattern;
+
+	  memset (&pattern, ch, sizeof (pattern));
+
+	  while ((in + n + 8 <= len) && (n + 8 <= MAX_RUN))
+	    {
+	      uint64_t  word;
+
+	      memcpy (&word, src + in + n, sizeof (word));
+
+	      if (word != pattern)
+		break;
+
+	      n += 8;
+	    }
+
+	  while ((in + n < len) && (n < MAX_RUN) && (src[in + n] == ch))
+	    n++;
+
+	  char  count = (char) (n - 1 + 29);
+
+	  while (('$' == count) || ('#' == count))
+	    {
+	      count--;
+	      n--;
+	    }
+
+	  dest[out++] = ch;
+	  dest[out++] = '*';
+	  dest[out++] = count;
+	  sum += (unsigned char) ch + (unsigned char) '*'
+	    + (unsigned char) count;
+	  in += n;
+	}
+    }
+
+  csum = (uint8_t) sum;
+  return  out;
+
+}	// encode ()
+
+
+//! Unescape a packet body in place
+
+//! Reverses escape (). Runs of chars without escapes are moved as a block.
+//! A '}' as the last char has nothing to escape, and is dropped.
+
+//! @param[in,out] buf  The packet body.
+//! @param[in]     len  Its length.
+//! @return  The length after unescaping.
+
+std::size_t
+RspCodec::unescape (char        *buf,
+		    std::size_t  len)
+{
+  std::size_t  first = sKernels->find4 (buf, len, '}', '}', '}', '}');
+  std::size_t  out   = first;
+  std::size_t  in    = first;
+
+  // Nothing moves until the first escape.
+  while (in < len)
+    {
+      in++;				// Skip the '}'
+
+      if (in < len)
+	buf[out++] = buf[in++] ^ 0x20;
+
+      std::size_t  run = sKernels->find4 (buf + in, len - in,
+					  '}', '}', '}', '}');
+
+      memmove (buf + out, buf + in, run);
+      in  += run;
+      out += run;
+    }
+
+  return  out;
+
+}	// unescape ()
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
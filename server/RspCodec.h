@@ -0,0 +1,145 @@
+// RSP frame encoding and decoding kernels: declaration
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RSP_CODEC_H
+#define RSP_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+
+
+//! Whole buffer operations for framing RSP packets
+
+//! All static functions. This class is not intended to be instantiated.
+
+//! The per character work of the RSP (the modulo 256 checksum, and finding
+//! the chars which must be escaped or which end a packet) is done over
+//! whole buffers by one of a set of kernels. On x86 there are SSE2 and AVX2
+//! kernels, and the best the CPU supports is picked at startup. Elsewhere,
+//! or if no vector unit is available, a portable scalar kernel is used.
+
+//! The vector kernels only speed up runs of ordinary chars. Escaping and
+//! unescaping are built on top of them, copying each run in one go. So is
+//! run length encoding, using a kernel to find where repeats start.
+
+class RspCodec
+{
+public:
+
+  //! The available kernels
+
+  enum class Kernel
+  {
+    SCALAR,
+    SSE2,
+    AVX2
+  };
+
+  // Kernel selection
+
+  static bool         setKernel (Kernel  k);
+  static Kernel       bestKernel ();
+  static Kernel       kernel ();
+  static const char * kernelName (Kernel  k);
+
+  // Whole buffer operations
+
+  static uint8_t      checksum (const char  *buf,
+				std::size_t  len);
+  static std::size_t  findSpecial (const char  *buf,
+				   std::size_t  len);
+  static std::size_t  findFrameEnd (const char  *buf,
+				    std::size_t  len);
+  static std::size_t  findRepeat (const char  *buf,
+				  std::size_t  len);
+  static std::size_t  escape (const char  *src,
+			      std::size_t  len,
+			      char        *dest,
+			      uint8_t     &csum);
+  static std::size_t  encode (const char  *src,
+			      std::size_t  len,
+			      char        *dest,
+			      uint8_t     &csum);
+  static std::size_t  unescape (char        *buf,
+				std::size_t  len);
+
+private:
+
+  //! Buffers shorter than this are done a char at a time, rather than
+  //! calling the kernel.
+
+  static const std::size_t  SHORT_LEN = 16;
+
+  //! The shortest run of chars worth run length encoding. A run is sent as
+  //! the char, '*' and a count, so anything shorter saves nothing.
+
+  static const std::size_t  MIN_RUN = 4;
+
+  //! The longest run of chars which can be run length encoded. The count is
+  //! sent as a printable char, the number of repeats + 29, and must not be
+  //! beyond '~'.
+
+  static const std::size_t  MAX_RUN = 1 + '~' - 29;
+
+  //! The functions making up one kernel
+
+  struct Kernels
+  {
+    Kernel  kernel;
+
+    //! Sum of all the chars in a buffer.
+
+    uint64_t  (*sum) (const char  *buf,
+		      std::size_t  len);
+
+    //! Offset of the first of any of four chars in a buffer, or its length
+    //! if there is none.
+
+    std::size_t  (*find4) (const char  *buf,
+			   std::size_t  len,
+			   char         c0,
+			   char         c1,
+			   char         c2,
+			   char         c3);
+
+    //! Offset of the first run of MIN_RUN identical chars in a buffer, or
+    //! its length if there is none.
+
+    std::size_t  (*findRun) (const char  *buf,
+			     std::size_t  len);
+  };
+
+  //! The kernel in use
+
+  static const Kernels *sKernels;
+
+  static const Kernels *lookup (Kernel  k);
+
+  // Private constructor cannot be instantiated
+  RspCodec () {};
+
+};	// class RspCodec
+
+#endif	// RSP_CODEC_H
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
@@ -0,0 +1,374 @@
+// RSP frame encoding and decoding kernels: microbenchmark
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+// Times checksumming, escaping and unescaping packet bodies with each of the
+// RspCodec kernels the CPU supports, against the char at a time loops the
+// server used before. Each is checked against the char at a time result.
+// Run length encoding zeroed memory is compared against plain escaping, and
+// checked by decoding as GDB would.
+
+// Usage: rsp-codec-bench [<packet size>]
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <cstdlib>
+#include <cstring>
+
+#include "RspCodec.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::fixed;
+using std::left;
+using std::right;
+using std::setprecision;
+using std::setw;
+using std::vector;
+
+
+//! The total bytes to push through each function being timed.
+
+static const std::size_t  BYTES_PER_RUN = 256 * 1024 * 1024;
+
+
+//! Char at a time checksum, as the server used to compute it
+
+//! @param[in] buf  The buffer.
+//! @param[in] len  Its length.
+//! @return  The checksum.
+
+static uint8_t
+refChecksum (const char  *buf,
+	     std::size_t  len)
+{
+  unsigned char  checksum = 0;
+
+  for (std::size_t  i = 0; i < len; i++)
+    checksum += (unsigned char) buf[i];
+
+  return  checksum;
+
+}	// refChecksum ()
+
+
+//! Char at a time escape, as the server used to do it in putPkt ()
+
+//! @param[in]     src   The packet body.
+//! @param[in]     len   Its length.
+//! @param[out]    dest  Where to put the escaped body.
+//! @param[in,out] csum  The checksum.
+//! @return  The length of the escaped body.
+
+static std::size_t
+refEscape (const char  *src,
+	   std::size_t  len,
+	   char        *dest,
+	   uint8_t     &csum)
+{
+  unsigned char  checksum = csum;
+  std::size_t    out      = 0;
+
+  for (std::size_t  count = 0; count < len; count++)
+    {
+      unsigned char  ch = src[count];
+
+      if (('$' == ch) || ('#' == ch) || ('*' == ch) || ('}' == ch))
+	{
+	  ch       ^= 0x20;
+	  checksum += (unsigned char)'}';
+	  dest[out++] = '}';
+	}
+
+      checksum += ch;
+      dest[out++] = ch;
+    }
+
+  csum = checksum;
+  return  out;
+
+}	// refEscape ()
+
+
+//! Char at a time unescape, as the server used to do it
+
+//! @param[in,out] buf  The escaped data.
+//! @param[in]     len  Its length.
+//! @return  The length after unescaping.
+
+static std::size_t
+refUnescape (char        *buf,
+	     std::size_t  len)
+{
+  std::size_t  fromOffset = 0;
+  std::size_t  toOffset   = 0;
+
+  while (fromOffset < len)
+    {
+      if ('}' == buf[fromOffset])
+	{
+	  fromOffset++;
+	  buf[toOffset] = buf[fromOffset] ^ 0x20;
+	}
+      else
+	buf[toOffset] = buf[fromOffset];
+
+      fromOffset++;
+      toOffset++;
+    }
+
+  return  toOffset;
+
+}	// refUnescape ()
+
+
+//! Decode a run length encoded and escaped body, as GDB would
+
+//! Runs are expanded as the frame is read, and escapes are removed
+//! afterwards.
+
+//! @param[in] buf  The encoded body.
+//! @param[in] len  Its length.
+//! @return  The decoded body.
+
+static vector<char>
+refDecode (const char  *buf,
+	   std::size_t  len)
+{
+  vector<char>  expanded;
+
+  for (std::size_t  i = 0; i < len; i++)
+    {
+      if (('*' == buf[i]) && (i + 1 < len) && !expanded.empty ())
+	{
+	  char  prev = expanded.back ();
+
+	  expanded.insert (expanded.end (), buf[++i] - 29, prev);
+	}
+      else
+	expanded.push_back (buf[i]);
+    }
+
+  expanded.resize (refUnescape (expanded.data (), expanded.size ()));
+  return  expanded;
+
+}	// refDecode ()
+
+
+//! Time a function over enough repeats to process BYTES_PER_RUN bytes
+
+//! @param[in] len  The bytes processed by each call.
+//! @param[in] fn   The function to time.
+//! @return  The throughput in MB/s.
+
+template <typename F>
+static double
+timeIt (std::size_t  len,
+	F            fn)
+{
+  std::size_t  reps  = BYTES_PER_RUN / len + 1;
+  auto         start = std::chrono::steady_clock::now ();
+
+  for (std::size_t  r = 0; r < reps; r++)
+    fn ();
+
+  std::chrono::duration<double>  secs =
+    std::chrono::steady_clock::now () - start;
+
+  return  (double) (reps * len) / secs.count () / 1.0e6;
+
+}	// timeIt ()
+
+
+//! One row of results
+
+//! @param[in] name      The name of the kernel.
+//! @param[in] csum      Checksum throughput in MB/s.
+//! @param[in] escHex    Escape throughput for hex data in MB/s.
+//! @param[in] escBin    Escape throughput for binary data in MB/s.
+//! @param[in] unescBin  Unescape throughput for binary data in MB/s.
+//! @param[in] rleZero   Encode throughput for zeroed memory in MB/s.
+
+static void
+report (const char *name,
+	double      csum,
+	double      escHex,
+	double      escBin,
+	double      unescBin,
+	double      rleZero)
+{
+  cout << left << setw (8) << name << right << fixed << setprecision (0)
+       << setw (12) << csum << setw (12) << escHex << setw (12) << escBin
+       << setw (12) << unescBin << setw (12) << rleZero << endl;
+
+}	// report ()
+
+
+//! Main program
+
+//! @param[in] argc  Number of arguments.
+//! @param[in] argv  The arguments. An optional packet size.
+//! @return  EXIT_SUCCESS if every kernel gave the same results as the char at
+//!          a time code, EXIT_FAILURE otherwise.
+
+int
+main (int   argc,
+      char *argv[])
+{
+  std::size_t  len = (argc > 1) ? strtoul (argv[1], nullptr, 0) : 0x10000;
+
+  if (0 == len)
+    {
+      cerr << "Usage: rsp-codec-bench [<packet size>]" << endl;
+      return  EXIT_FAILURE;
+    }
+
+  // Hex data, as in memory and register replies, has nothing to escape.
+  // Random binary data, as in X packets, has an escape every 64 chars.
+  std::mt19937  gen (42);
+  // Zeroed memory, as read from BSS, is all '0' in hex. A mix of runs of
+  // all lengths, including of chars which must be escaped, checks encoding.
+  vector<char>  hex (len);
+  vector<char>  bin (len);
+  vector<char>  zero (len, '0');
+  vector<char>  mixed;
+
+  for (std::size_t  i = 0; i < len; i++)
+    {
+      hex[i] = "0123456789abcdef"[gen () & 0xf];
+      bin[i] = (char) (gen () & 0xff);
+    }
+
+  while (mixed.size () < len)
+    mixed.insert (mixed.end (), gen () % 200 + 1, "0f$#*}"[gen () % 6]);
+
+  mixed.resize (len);
+
+  vector<char>  dest (len * 2);
+  vector<char>  work (len * 2);
+  uint8_t       refBinSum = 0;
+  std::size_t   escLen    = refEscape (bin.data (), len, work.data (),
+					 refBinSum);
+  vector<char>  escaped (work.begin (), work.begin () + escLen);
+  uint8_t       refHexSum = refChecksum (hex.data (), len);
+  volatile uint8_t      sink = 0;
+  volatile std::size_t  sinkLen = 0;
+  bool          ok = true;
+
+  cout << "Packet size " << len << " bytes, results in MB/s" << endl;
+  cout << left << setw (8) << "Kernel" << right << setw (12) << "checksum"
+       << setw (12) << "escape hex" << setw (12) << "escape bin"
+       << setw (12) << "unescape" << setw (12) << "rle zeros" << endl;
+
+  // The char at a time code, as the baseline.
+  double  csum = timeIt (len, [&] {
+      sink = refChecksum (hex.data (), len); });
+  double  escHex = timeIt (len, [&] {
+      uint8_t  c = 0;
+      sinkLen = refEscape (hex.data (), len, dest.data (), c); });
+  double  escBin = timeIt (len, [&] {
+      uint8_t  c = 0;
+      sinkLen = refEscape (bin.data (), len, dest.data (), c); });
+  double  unescBin = timeIt (escLen, [&] {
+      memcpy (work.data (), escaped.data (), escLen);
+      sinkLen = refUnescape (work.data (), escLen); });
+  double  rleZero = timeIt (len, [&] {
+      uint8_t  c = 0;
+      sinkLen = refEscape (zero.data (), len, dest.data (), c); });
+
+  report ("bytewise", csum, escHex, escBin, unescBin, rleZero);
+
+  // Each kernel we have.
+  const RspCodec::Kernel  kernels[] = {
+    RspCodec::Kernel::SCALAR,
+    RspCodec::Kernel::SSE2,
+    RspCodec::Kernel::AVX2
+  };
+
+  for (auto k : kernels)
+    {
+      if (!RspCodec::setKernel (k))
+	{
+	  cout << left << setw (8) << RspCodec::kernelName (k)
+	       << "  not supported" << endl;
+	  continue;
+	}
+
+      // Check the results first.
+      uint8_t  c = 0;
+      bool     good = (RspCodec::checksum (hex.data (), len) == refHexSum)
+	&& (RspCodec::escape (bin.data (), len, dest.data (), c) == escLen)
+	&& (c == refBinSum)
+	&& (0 == memcmp (dest.data (), escaped.data (), escLen));
+
+      memcpy (work.data (), escaped.data (), escLen);
+      good = good && (RspCodec::unescape (work.data (), escLen) == len)
+	&& (0 == memcmp (work.data (), bin.data (), len));
+
+      c = 0;
+      std::size_t  encLen = RspCodec::encode (mixed.data (), len,
+					      dest.data (), c);
+      good = good && (refDecode (dest.data (), encLen) == mixed)
+	&& (refChecksum (dest.data (), encLen) == c)
+	&& (nullptr == memchr (dest.data (), '$', encLen))
+	&& (nullptr == memchr (dest.data (), '#', encLen));
+
+      if (!good)
+	{
+	  cerr << "ERROR: " << RspCodec::kernelName (k)
+	       << " kernel gives wrong results" << endl;
+	  ok = false;
+	  continue;
+	}
+
+      csum = timeIt (len, [&] {
+	  sink = RspCodec::checksum (hex.data (), len); });
+      escHex = timeIt (len, [&] {
+	  uint8_t  c = 0;
+	  sinkLen = RspCodec::escape (hex.data (), len, dest.data (), c); });
+      escBin = timeIt (len, [&] {
+	  uint8_t  c = 0;
+	  sinkLen = RspCodec::escape (bin.data (), len, dest.data (), c); });
+      unescBin = timeIt (escLen, [&] {
+	  memcpy (work.data (), escaped.data (), escLen);
+	  sinkLen = RspCodec::unescape (work.data (), escLen); });
+      rleZero = timeIt (len, [&] {
+	  uint8_t  c = 0;
+	  sinkLen = RspCodec::encode (zero.data (), len, dest.data (), c); });
+
+      report (RspCodec::kernelName (k), csum, escHex, escBin, unescBin,
+	      rleZero);
+    }
+
+  (void) sink;
+  (void) sinkLen;
+  return  ok ? EXIT_SUCCESS : EXIT_FAILURE;
+
+}	// main ()
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
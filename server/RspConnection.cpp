@@ -56,21 +56,42 @@ using std::setw;
 //! @param[in] _traceFlags  flags controlling tracing
 RspConnection::RspConnection (int         _portNum,
 			      TraceFlags *_traceFlags) :
-  AbstractConnection (_traceFlags),
+  FdConnection (_traceFlags),
   portNum (_portNum),
-  clientFd (-1)
+  listenFd (-1)
 {
 
 }	// RspConnection ()
 
 
+//! Constructor when given a client which has already been accepted
+
+//! Used when something else (such as a SessionManager) owns the listening
+//! socket. We serve only this one client, so can't reconnect.
+
+//! @param[in] _traceFlags  flags controlling tracing
+//! @param[in] _clientFd    the accepted client file descriptor
+RspConnection::RspConnection (TraceFlags *_traceFlags,
+			      int         _clientFd) :
+  FdConnection (_traceFlags, _clientFd),
+  portNum (-1),
+  listenFd (-1)
+{
+  initClient ();
+
+}	// RspConnection ()
+
+
 //! Destructor
 
-//! Close the connection if it is still open
+//! Close the connection if it is still open, and stop listening.
 RspConnection::~RspConnection ()
 {
   this->rspClose ();		// Don't confuse with any other close ()
 
+  if (listenFd >= 0)
+    close (listenFd);
+
 }	// ~RspConnection ()
 
 
@@ -82,7 +103,10 @@ RspConnection::~RspConnection ()
 
 //! This involves setting up a socket to listen on a socket for attempted
 //! connections from a single GDB instance (we couldn't be talking to multiple
-//! GDBs at once!).
+//! GDBs at once!).  The listening socket is created on the first call and
+//! kept open until we are destroyed, so a GDB which connects while we are
+//! busy with another, or between clients, waits in the backlog rather than
+//! being refused.
 
 //! The service is specified either as a port number in the Or1ksim
 //! configuration (parameter rsp_port in section debug, default 51000) or as a
@@ -98,44 +122,27 @@ RspConnection::~RspConnection ()
 bool
 RspConnection::rspConnect ()
 {
-  // Open a socket on which we'll listen for clients
-  int  tmpFd = socket (PF_INET, SOCK_STREAM, IPPROTO_TCP);
-  if (tmpFd < 0)
+  if (-1 == portNum)
     {
-      cerr << "ERROR: Cannot open RSP socket" << endl;
+      cerr << "ERROR: Cannot reconnect to an accepted RSP client" << endl;
       return  false;
     }
 
-  // Allow rapid reuse of the port on this socket
-  int  optval = 1;
-  setsockopt (tmpFd, SOL_SOCKET, SO_REUSEADDR, (char *)&optval,
-	      sizeof (optval));
-
-  // Bind the port to the socket
-  struct sockaddr_in  sockAddr;
-  sockAddr.sin_family      = PF_INET;
-  sockAddr.sin_port        = htons (portNum);
-  sockAddr.sin_addr.s_addr = INADDR_ANY;
-
-  if (bind (tmpFd, (struct sockaddr *) &sockAddr, sizeof (sockAddr)))
+  // Open the socket on which we'll listen for clients, if not already open
+  if (listenFd < 0)
     {
-      cerr << "ERROR: Cannot bind to RSP socket" << endl;
-      return  false;
-    }
-
-  // Listen for (at most one) client
-  if (listen (tmpFd, 1))
-    {
-      cerr << "ERROR: Cannot listen on RSP socket" << endl;
-      return  false;
+      listenFd = listenOn (portNum, SOMAXCONN);
+      if (listenFd < 0)
+	return  false;
     }
 
   if (! traceFlags->traceSilent ())
     cout << "Listening for RSP on port " <<  portNum << endl << flush;
 
   // Accept a client which connects
+  struct sockaddr_in  sockAddr;
   socklen_t  len = sizeof (sockAddr);		// Size of the socket address
-  clientFd = accept (tmpFd, (struct sockaddr *)&sockAddr, &len);
+  clientFd = accept (listenFd, (struct sockaddr *)&sockAddr, &len);
 
   if (-1 == clientFd)
     {
@@ -144,154 +151,93 @@ RspConnection::rspConnect ()
       return  true;			// OK to retry
     }
 
-  // Enable TCP keep alive process
-  optval = 1;
-  setsockopt (clientFd, SOL_SOCKET, SO_KEEPALIVE, (char *)&optval,
-	      sizeof (optval));
-
-  // Don't delay small packets, for better interactive response (disable
-  // Nagel's algorithm)
-  optval = 1;
-  setsockopt (clientFd, IPPROTO_TCP, TCP_NODELAY, (char *)&optval,
-	      sizeof (optval));
-
-  // Socket is no longer needed
-  close (tmpFd);			// No longer need this
-  signal (SIGPIPE, SIG_IGN);		// So we don't exit if client dies
-
   if (! traceFlags->traceSilent ())
     cout << "Remote debugging from host " << inet_ntoa (sockAddr.sin_addr)
 	 << endl;
 
+  initClient ();
   return true;
 
 }	// rspConnect ()
 
 
-//! Close a client connection if it is open
-void
-RspConnection::rspClose ()
+//! Create a socket listening on a port
+
+//! @param[in] portNum  The port to listen on.
+//! @param[in] backlog  How many clients may be waiting to be accepted.
+//! @return  The listening file descriptor, or -1 on failure.
+int
+RspConnection::listenOn (int  portNum,
+			 int  backlog)
 {
-  if (isConnected ())
+  int  tmpFd = socket (PF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (tmpFd < 0)
     {
-      if (! traceFlags->traceSilent ())
-	cout << "Closing connection" << endl;
-
-      close (clientFd);
-      clientFd = -1;
+      cerr << "ERROR: Cannot open RSP socket" << endl;
+      return  -1;
     }
-}	// rspClose ()
 
+  // Allow rapid reuse of the port on this socket
+  int  optval = 1;
+  setsockopt (tmpFd, SOL_SOCKET, SO_REUSEADDR, (char *)&optval,
+	      sizeof (optval));
 
-//! Report if we are connected to a client.
-
-//! @return  TRUE if we are connected, FALSE otherwise
-bool
-RspConnection::isConnected ()
-{
-  return -1 != clientFd;
+  // Bind the port to the socket
+  struct sockaddr_in  sockAddr;
+  sockAddr.sin_family      = PF_INET;
+  sockAddr.sin_port        = htons (portNum);
+  sockAddr.sin_addr.s_addr = INADDR_ANY;
 
-}	// isConnected ()
+  if (bind (tmpFd, (struct sockaddr *) &sockAddr, sizeof (sockAddr)))
+    {
+      cerr << "ERROR: Cannot bind to RSP socket" << endl;
+      close (tmpFd);
+      return  -1;
+    }
 
-//! Put a single character out on the RSP connection
+  if (listen (tmpFd, backlog))
+    {
+      cerr << "ERROR: Cannot listen on RSP socket" << endl;
+      close (tmpFd);
+      return  -1;
+    }
 
-//! Utility routine. This should only be called if the client is open, but we
-//! check for safety.
+  return  tmpFd;
 
-//! @param[in] c         The character to put out
+}	// listenOn ()
 
-//! @return  TRUE if char sent OK, FALSE if not (communications failure)
 
-bool
-RspConnection::putRspCharRaw (char  c)
+//! Set up a newly accepted client and start reading from it.
+void
+RspConnection::initClient ()
 {
-  if (-1 == clientFd)
-    {
-      cerr << "Warning: Attempt to write '" << c
-		<< "' to unopened RSP client: Ignored" << endl;
-      return  false;
-    }
+  // Enable TCP keep alive process
+  int  optval = 1;
+  setsockopt (clientFd, SOL_SOCKET, SO_KEEPALIVE, (char *)&optval,
+	      sizeof (optval));
 
-  // Write until successful (we retry after interrupts) or catastrophic
-  // failure.
-  while (true)
-    {
-      switch (write (clientFd, &c, sizeof (c)))
-	{
-	case -1:
-	  // Error: only allow interrupts or would block
-	  if ((EAGAIN != errno) && (EINTR != errno))
-	    {
-	      cerr << "Warning: Failed to write to RSP client: "
-			<< "Closing client connection: "
-			<<  strerror (errno) << endl;
-	      return  false;
-	    }
-
-	  break;
-
-	case 0:
-	  break;		// Nothing written! Try again
-
-	default:
-	  return  true;		// Success, we can return
-	}
-    }
-}	// putRspCharRaw ()
+  // Don't delay small packets, for better interactive response (disable
+  // Nagel's algorithm)
+  optval = 1;
+  setsockopt (clientFd, IPPROTO_TCP, TCP_NODELAY, (char *)&optval,
+	      sizeof (optval));
 
+  signal (SIGPIPE, SIG_IGN);		// So we don't exit if client dies
 
-//! Get a single character from the RSP connection
+  startReader ();
 
-//! Utility routine. This should only be called if the client is open, but we
-//! check for safety.
+}	// initClient ()
 
-//! @param[in] blocking  True if the read should block.
-//! @return  The character received or -1 on failure, or if the read would
-//!          block, and blocking is true.
 
-int
-RspConnection::getRspCharRaw (bool blocking)
-{
-  if (-1 == clientFd)
-    {
-      cerr << "Warning: Attempt to read from "
-  	   << "unopened RSP client: Ignored" << endl;
-      return  -1;
-    }
+//! Can we make a new connection once this one closes?
 
-  // Blocking read until successful (we retry after interrupts) or
-  // catastrophic failure.
+//! @return  TRUE unless we were given an already accepted client.
+bool
+RspConnection::canReconnect ()
+{
+  return  -1 != portNum;
 
-  for (;;)
-    {
-      unsigned char  c;
-
-      switch (recv (clientFd, &c, sizeof (c), (blocking ? 0 : MSG_DONTWAIT)))
-  	{
-  	case -1:
-	  if (!blocking
-	      && (errno == EAGAIN || errno == EWOULDBLOCK))
-	    return -1;
-
-  	  // Error: only allow interrupts
-
-  	  if (EINTR != errno)
-  	    {
-  	      cerr << "Warning: Failed to read from RSP client: "
-  		   << "Closing client connection: "
-  		   <<  strerror (errno) << endl;
-  	      return  -1;
-  	    }
-  	  break;
-
-  	case 0:
-  	  return  -1;
-
-  	default:
-  	  return  c & 0xff;	// Success, we can return (no sign extend!)
-  	}
-    }
-}	// getRspCharRaw ()
+}	// canReconnect ()
 
 
 // Local Variables:
@@ -22,7 +22,7 @@
 #ifndef RSP_CONNECTION_H
 #define RSP_CONNECTION_H
 
-#include "AbstractConnection.h"
+#include "FdConnection.h"
 #include "RspPacket.h"
 #include "TraceFlags.h"
 
@@ -31,7 +31,7 @@
 //! This class is entirely passive. It is up to the caller to determine that a
 //! packet will become available before calling ::getPkt ().
 
-class RspConnection : public AbstractConnection
+class RspConnection : public FdConnection
 {
 public:
 
@@ -39,28 +39,35 @@ public:
 
   RspConnection (int         _portNum,
 		 TraceFlags *_traceFlags);
+  RspConnection (TraceFlags *_traceFlags,
+		 int         _clientFd);
   ~RspConnection ();
 
   // Public interface: manage client connections
 
   bool  rspConnect ();
-  void  rspClose ();
-  bool  isConnected ();
+  bool  canReconnect ();
+
+  // Create a socket listening on a port
+
+  static int  listenOn (int  portNum,
+			int  backlog);
 
 private:
 
-  //! The port number to listen on
+  //! The port number to listen on, or -1 if we were given an accepted
+  //! client.
 
   int  portNum;
 
-  //! The client file descriptor
+  //! The socket listening for clients, or -1 if not yet listening.  Kept
+  //! open between clients.
 
-  int  clientFd;
+  int  listenFd;
 
-  // Implementation specific routines to handle individual chars.
+  // Set up a newly accepted client
 
-  virtual bool  putRspCharRaw (char  c);
-  virtual int   getRspCharRaw (bool blocking);
+  void  initClient ();
 
 };	// RspConnection ()
 
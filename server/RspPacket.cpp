@@ -46,9 +46,11 @@ using std::setw;
 //! @param[in]  _rspConnection  The RSP connection we will use
 //! @param[in]  _bufSize        Size of data buffer to allocate
 RspPacket::RspPacket (int  _bufSize) :
-  bufSize (_bufSize)
+  bufSize (_bufSize),
+  len (0)
 {
   data = new char [_bufSize];
+  data[0] = 0;
 
 }	// RspPacket ();
 
@@ -63,6 +65,33 @@ RspPacket::~RspPacket ()
 }	// ~RspPacket ()
 
 
+//! Make sure the buffer is at least a given size
+
+//! The buffer is at least doubled if it has to grow, so repeatedly growing a
+//! packet is cheap. The current contents are kept.
+
+//! @param[in] size  The number of chars needed, including any EOS.
+void
+RspPacket::reserve (std::size_t  size)
+{
+  if (size <= bufSize)
+    return;
+
+  std::size_t  newSize = bufSize * 2;
+
+  if (newSize < size)
+    newSize = size;
+
+  char *newData = new char [newSize];
+
+  memcpy (newData, data, len < bufSize ? len + 1 : bufSize);
+  delete [] data;
+  data    = newData;
+  bufSize = newSize;
+
+}	// reserve ()
+
+
 //! Pack a string into a packet.
 
 //! A convenience version of this method.
@@ -73,16 +102,10 @@ RspPacket::packStr (const char *str)
 {
   std::size_t slen = strlen (str);
 
-  // Construct the packet to send, so long as string is not too big, otherwise
-  // truncate. Add EOS at the end for convenient debug printout
-  if (slen >= bufSize)
-    {
-      cerr << "Warning: String \"" << str
-		<< "\" too large for RSP packet: truncated\n" << endl;
-      slen = bufSize - 1;
-    }
-
-  strncpy (data, str, slen);
+  // Construct the packet to send, growing the buffer if the string is too
+  // big. Add EOS at the end for convenient debug printout
+  reserve (slen + 1);
+  memcpy (data, str, slen);
   data[slen] = 0;
   len        = slen;
 
@@ -99,14 +122,9 @@ RspPacket::packHexstr (const char *str)
 {
   std::size_t slen = strlen (str);
 
-  // Construct the packet to send, so long as string is not too big, otherwise
-  // truncate. Add EOS at the end for convenient debug printout
-  if (slen >= (bufSize / 2 - 1))
-    {
-      cerr << "Warning: String \"" << str
-		<< "\" too large for RSP packet: truncated\n" << endl;
-      slen = bufSize / 2 - 1;
-    }
+  // Construct the packet to send, growing the buffer if the string is too
+  // big. Add EOS at the end for convenient debug printout
+  reserve (slen * 2 + 2);
 
   // Construct the string the hard way
   data[0] = 'O';
@@ -140,14 +158,9 @@ RspPacket::packRcmdStr (const char *str,
 {
   std::size_t slen = strlen (str);
 
-  // Construct the packet to send, so long as string is not too big, otherwise
-  // truncate. Add EOS at the end for convenient debug printout
-  if (slen >= (bufSize / 2 - 1))
-    {
-      cerr << "Warning: String \"" << str
-		<< "\" too large for RSP packet: truncated\n" << endl;
-      slen = bufSize / 2 - 1;
-    }
+  // Construct the packet to send, growing the buffer if the string is too
+  // big. Add EOS at the end for convenient debug printout
+  reserve (slen * 2 + 2);
 
   // Construct the string the hard way
   int offset;
@@ -23,12 +23,18 @@
 #ifndef RSP_PACKET_H
 #define RSP_PACKET_H
 
+#include <cstddef>
 #include <iostream>
 
 
 //! Class for RSP packets
 
 //! Can't be null terminated, since it may include zero bytes
+
+//! The packet owns its buffer, which is reused from packet to packet. It is
+//! grown as needed, by the pack functions or explicitly with reserve (), so
+//! it is never overrun. Growing may move the buffer, so don't keep a pointer
+//! to data across calls which may grow it.
 class RspPacket
 {
 public:
@@ -40,6 +46,9 @@ public:
   RspPacket (int  _bufSize);
   ~RspPacket ();
 
+  // Make sure the buffer is at least a given size
+  void  reserve (std::size_t  size);
+
   // Pack a constant string into a packet
   void  packStr (const char * str);	// For fixed packets
   void  packRcmdStr (const char * str,	// For qRcmd replies
@@ -0,0 +1,250 @@
+// Multi-session RSP server: implementation
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#include <chrono>
+#include <iostream>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "SessionManager.h"
+#include "GdbServer.h"
+#include "ITarget.h"
+#include "RspConnection.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::flush;
+
+
+//! Constructor
+
+//! @param[in] _portNum     The TCP port to listen on
+//! @param[in] _numWorkers  How many sessions may run at once
+//! @param[in] _makeTarget  Function to create the target for a session
+//! @param[in] _traceFlags  Flags controlling tracing
+SessionManager::SessionManager (int            _portNum,
+				int            _numWorkers,
+				TargetFactory  _makeTarget,
+				TraceFlags    *_traceFlags) :
+  portNum (_portNum),
+  numWorkers (_numWorkers),
+  makeTarget (_makeTarget),
+  traceFlags (_traceFlags),
+  flashStart (0),
+  flashLength (0),
+  listenFd (-1),
+  mStopping (false)
+{
+  // Nothing.
+
+}	// SessionManager ()
+
+
+//! Destructor
+
+//! Stop accepting clients, let the workers finish the sessions already
+//! queued, and wait for them.
+SessionManager::~SessionManager ()
+{
+  if (listenFd >= 0)
+    close (listenFd);
+
+  {
+    std::lock_guard<std::mutex>  lock (mMutex);
+    mStopping = true;
+  }
+
+  mCond.notify_all ();
+
+  for (auto &worker : mWorkers)
+    worker.join ();
+
+}	// ~SessionManager ()
+
+
+//! Treat a region of memory as flash in every session
+
+//! @see GdbServer::flashRegion ()
+
+//! @param[in] start   The first address in the region.
+//! @param[in] length  The size of the region in bytes.
+void
+SessionManager::flashRegion (uint32_t  start,
+			     uint32_t  length)
+{
+  flashStart  = start;
+  flashLength = length;
+
+}	// flashRegion ()
+
+
+//! Accept and serve clients
+
+//! Clients are accepted as soon as they connect, and queued for the next
+//! free worker.
+
+//! @return  EXIT_FAILURE if we could not listen, or accepting failed.  We
+//!          never return otherwise.
+int
+SessionManager::run ()
+{
+  listenFd = RspConnection::listenOn (portNum, SOMAXCONN);
+
+  if (listenFd < 0)
+    return  EXIT_FAILURE;
+
+  signal (SIGPIPE, SIG_IGN);		// So we don't exit if a client dies
+
+  for (int  i = 0; i < numWorkers; i++)
+    mWorkers.emplace_back (&SessionManager::workerThread, this);
+
+  if (! traceFlags->traceSilent ())
+    cout << "Listening for RSP on port " << portNum << " with "
+	 << numWorkers << " session workers" << endl << flush;
+
+  for (uint64_t  sessionNum = 1; ; sessionNum++)
+    {
+      struct sockaddr_in  sockAddr;
+      socklen_t  len = sizeof (sockAddr);
+      int  clientFd = accept (listenFd, (struct sockaddr *) &sockAddr, &len);
+
+      if (-1 == clientFd)
+	{
+	  if ((EINTR == errno) || (ECONNABORTED == errno))
+	    continue;
+
+	  cerr << "ERROR: Failed to accept RSP client: " << strerror (errno)
+	       << endl;
+	  return  EXIT_FAILURE;
+	}
+
+      std::lock_guard<std::mutex>  lock (mMutex);
+
+      if (! traceFlags->traceSilent ())
+	cout << "Session " << sessionNum << ": remote debugging from host "
+	     << inet_ntoa (sockAddr.sin_addr) << endl;
+
+      mPending.push_back (std::make_pair (sessionNum, clientFd));
+      mCond.notify_one ();
+    }
+}	// run ()
+
+
+//! Worker thread
+
+//! Take clients from the queue and serve each until it has finished.
+void
+SessionManager::workerThread ()
+{
+  while (true)
+    {
+      std::pair<uint64_t, int>  next;
+
+      {
+	std::unique_lock<std::mutex>  lock (mMutex);
+	mCond.wait (lock, [this] { return mStopping || !mPending.empty (); });
+
+	if (mPending.empty ())
+	  return;			// Stopping
+
+	next = mPending.front ();
+	mPending.pop_front ();
+      }
+
+      runSession (next.first, next.second);
+    }
+}	// workerThread ()
+
+
+//! Serve one client
+
+//! The target, connection and server all belong to this session, and are
+//! deleted when the client disconnects or kills the target.  They share a
+//! copy of the trace flags, which belongs to this session too, so the
+//! client can change them without racing with other sessions.
+
+//! @param[in] sessionNum  The number of this session, for reporting
+//! @param[in] clientFd    The accepted client socket
+void
+SessionManager::runSession (uint64_t  sessionNum,
+			    int       clientFd)
+{
+  auto  wallStart = std::chrono::steady_clock::now ();
+  struct timespec  cpuStart;
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &cpuStart);
+
+  TraceFlags  sessionFlags (*traceFlags);
+  ITarget *cpu = makeTarget (&sessionFlags);
+
+  if (nullptr == cpu)
+    {
+      close (clientFd);
+      return;
+    }
+
+  RspConnection *conn = new RspConnection (&sessionFlags, clientFd);
+  GdbServer *gdbServer =
+    new GdbServer (conn, cpu, &sessionFlags,
+		   GdbServer::KillBehaviour::EXIT_ON_KILL);
+  cpu->gdbServer (gdbServer);
+
+  if (flashLength > 0)
+    gdbServer->flashRegion (flashStart, flashLength);
+
+  gdbServer->rspServer ();
+
+  uint64_t  cycles = cpu->getCycleCount ();
+  uint64_t  instrs = cpu->getInstrCount ();
+
+  delete  conn;				// Closes the client
+  delete  gdbServer;
+  delete  cpu;
+
+  struct timespec  cpuEnd;
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &cpuEnd);
+  std::chrono::duration<double>  wall =
+    std::chrono::steady_clock::now () - wallStart;
+  double  cpuTime = (double) (cpuEnd.tv_sec - cpuStart.tv_sec)
+    + (double) (cpuEnd.tv_nsec - cpuStart.tv_nsec) / 1.0e9;
+
+  if (! sessionFlags.traceSilent ())
+    {
+      std::lock_guard<std::mutex>  lock (mMutex);
+
+      cout << "Session " << sessionNum << ": ended after " << wall.count ()
+	   << " s wall, " << cpuTime << " s CPU, " << cycles << " cycles, "
+	   << instrs << " instructions" << endl;
+    }
+}	// runSession ()
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
@@ -0,0 +1,138 @@
+// Multi-session RSP server: declaration
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SESSION_MANAGER_H
+#define SESSION_MANAGER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TraceFlags.h"
+
+class ITarget;
+
+
+//! Serve many GDB clients from one listening TCP port
+
+//! Each client which connects gets a session of its own: a fresh target, a
+//! GdbServer and an RspConnection for the accepted socket. Sessions are
+//! queued and run by a fixed pool of worker threads. A session keeps its
+//! worker until the client disconnects or kills the target, since the RSP
+//! loop blocks waiting for the client. So the pool size is the number of
+//! clients served at once, and later clients wait in the queue.
+
+//! When a session ends its wall clock time, the CPU time of its worker
+//! thread and the cycles and instructions executed by its target are
+//! reported.
+
+class SessionManager
+{
+public:
+
+  //! Function to create a new target for a session, with the session's
+  //! trace flags.  Called on the worker thread which will run the session.
+
+  typedef std::function<ITarget * (TraceFlags *)>  TargetFactory;
+
+  // Constructor and destructor
+
+  SessionManager (int            _portNum,
+		  int            _numWorkers,
+		  TargetFactory  _makeTarget,
+		  TraceFlags    *_traceFlags);
+  ~SessionManager ();
+
+  // Treat a region of memory as flash in every session
+
+  void  flashRegion (uint32_t  start,
+		     uint32_t  length);
+
+  // Accept and serve clients. Only returns on failure.
+
+  int  run ();
+
+private:
+
+  //! The port number to listen on
+
+  int  portNum;
+
+  //! The number of worker threads
+
+  int  numWorkers;
+
+  //! How to create a target for each session
+
+  TargetFactory  makeTarget;
+
+  //! Our trace flags.  Each session has a copy of its own, so changing
+  //! them with "monitor set debug" only affects that session.
+
+  TraceFlags *traceFlags;
+
+  //! The region each session treats as flash. None if the length is zero.
+
+  uint32_t  flashStart;
+  uint32_t  flashLength;
+
+  //! The listening socket, or -1 if not listening
+
+  int  listenFd;
+
+  //! Accepted client file descriptors waiting for a worker, with the
+  //! session number each was given.
+
+  std::deque<std::pair<uint64_t, int> >  mPending;
+
+  //! Guards mPending, mStopping and the console output of sessions.
+
+  std::mutex  mMutex;
+
+  //! Signalled when a client is added to mPending, or on stopping.
+
+  std::condition_variable  mCond;
+
+  //! Set to tell the workers to exit once the queue is empty.
+
+  bool  mStopping;
+
+  //! The worker threads
+
+  std::vector<std::thread>  mWorkers;
+
+  // Implementation
+
+  void  workerThread ();
+  void  runSession (uint64_t  sessionNum,
+		    int       clientFd);
+
+};	// SessionManager ()
+
+#endif	// SESSION_MANAGER_H
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
@@ -0,0 +1,370 @@
+// Shared memory RSP client: implementation
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ShmClient.h"
+#include "Utils.h"
+
+using std::cerr;
+using std::endl;
+using std::string;
+
+
+//! Constructor
+
+ShmClient::ShmClient () :
+  mRegion (nullptr),
+  mNoAckMode (false),
+  mRxLen (0),
+  mRxPos (0)
+{
+  // Nothing.
+
+}	// ShmClient ()
+
+
+//! Destructor
+
+//! Detach if still attached.
+
+ShmClient::~ShmClient ()
+{
+  disconnect ();
+
+}	// ~ShmClient ()
+
+
+//! Attach to a server
+
+//! The server must have created the region. If it is not yet waiting for a
+//! client, we wait up to CONNECT_TRIES futex timeouts for it to be ready.
+
+//! @param[in] name  The name of the shared memory object, as given to the
+//!                  server.
+//! @return  TRUE if we attached, FALSE otherwise.
+
+bool
+ShmClient::connect (const char *name)
+{
+  string  shmName (name);
+
+  if ('/' != shmName[0])
+    shmName.insert (0, "/");
+
+  int  fd = shm_open (shmName.c_str (), O_RDWR, 0);
+
+  if (fd < 0)
+    {
+      cerr << "Warning: Cannot open RSP shared memory " << shmName << ": "
+	   << strerror (errno) << endl;
+      return  false;
+    }
+
+  void *addr = mmap (nullptr, sizeof (ShmRegion), PROT_READ | PROT_WRITE,
+		     MAP_SHARED, fd, 0);
+  close (fd);
+
+  if (MAP_FAILED == addr)
+    {
+      cerr << "Warning: Cannot map RSP shared memory: " << strerror (errno)
+	   << endl;
+      return  false;
+    }
+
+  ShmRegion *region = static_cast<ShmRegion *> (addr);
+
+  // Claim the connection. The server may still be tidying up after a
+  // previous client, so we give it a little while to start listening.
+  for (int  i = 0; ; i++)
+    {
+      uint32_t  state = ShmRegion::LISTENING;
+
+      if ((ShmRegion::MAGIC == region->magic.load ())
+	  && region->state.compare_exchange_strong (state,
+						    ShmRegion::CONNECTED))
+	break;
+
+      if (i >= CONNECT_TRIES)
+	{
+	  cerr << "Warning: RSP server " << shmName << " is not listening"
+	       << endl;
+	  munmap (addr, sizeof (ShmRegion));
+	  return  false;
+	}
+
+      shmFutexWait (region->state, state);
+    }
+
+  region->clientPid.store (getpid ());
+  shmFutexWake (region->state);
+
+  mRegion    = region;
+  mNoAckMode = false;
+  mRxLen     = 0;
+  mRxPos     = 0;
+  return  true;
+
+}	// connect ()
+
+
+//! Detach from the server
+
+//! The server sees the connection close, just as if GDB had disconnected.
+
+void
+ShmClient::disconnect ()
+{
+  if (nullptr == mRegion)
+    return;
+
+  mRegion->state.store (ShmRegion::CLOSED);
+  shmFutexWake (mRegion->state);
+  shmFutexWake (mRegion->toServer.tail);
+  shmFutexWake (mRegion->toClient.head);
+  munmap (mRegion, sizeof (ShmRegion));
+  mRegion = nullptr;
+
+}	// disconnect ()
+
+
+//! Set whether we are in no-ack mode.
+
+//! Call this once the server has replied OK to QStartNoAckMode.
+
+//! @param[in] noAckMode  TRUE to stop using acknowledgements, FALSE to use
+//!                       them.
+
+void
+ShmClient::setNoAckMode (bool  noAckMode)
+{
+  mNoAckMode = noAckMode;
+
+}	// setNoAckMode ()
+
+
+//! Send a packet to the server
+
+//! The complete frame is built and written in one go. Unless in no-ack mode,
+//! we resend until the server acknowledges it.
+
+//! @param[in] data  The packet contents, without framing or escapes.
+//! @return  TRUE on success, FALSE if the connection has failed.
+
+bool
+ShmClient::putPkt (const string &data)
+{
+  string         frame ("$");
+  unsigned char  checksum = 0;
+
+  for (string::size_type  i = 0; i < data.size (); i++)
+    {
+      unsigned char  ch = data[i];
+
+      if (('$' == ch) || ('#' == ch) || ('*' == ch) || ('}' == ch))
+	{
+	  ch       ^= 0x20;
+	  checksum += (unsigned char) '}';
+	  frame    += '}';
+	}
+
+      checksum += ch;
+      frame    += (char) ch;
+    }
+
+  frame += '#';
+  frame += Utils::hex2Char (checksum >> 4);
+  frame += Utils::hex2Char (checksum % 16);
+
+  for (;;)
+    {
+      if (!putBlock (frame.data (), frame.size ()))
+	return  false;
+
+      if (mNoAckMode)
+	return  true;
+
+      int  ch = getChar ();
+
+      if (-1 == ch)
+	return  false;
+      else if ('+' == ch)
+	return  true;
+    }
+}	// putPkt ()
+
+
+//! Get a packet from the server
+
+//! Run length encoding and escapes are undone, and unless in no-ack mode the
+//! packet is acknowledged.
+
+//! @param[out] data  The packet contents.
+//! @return  TRUE on success, FALSE if the connection has failed.
+
+bool
+ShmClient::getPkt (string &data)
+{
+  for (;;)
+    {
+      int  ch;
+
+      // Wait for the start char, skipping any stray acks
+      do
+	{
+	  ch = getChar ();
+	  if (-1 == ch)
+	    return  false;
+	}
+      while ('$' != ch);
+
+      unsigned char  checksum = 0;
+      bool           escaped  = false;
+
+      data.clear ();
+
+      while (true)
+	{
+	  ch = getChar ();
+	  if (-1 == ch)
+	    return  false;
+
+	  if ('#' == ch)
+	    break;
+
+	  checksum += (unsigned char) ch;
+
+	  if (escaped)
+	    {
+	      data    += (char) (ch ^ 0x20);
+	      escaped  = false;
+	    }
+	  else if ('}' == ch)
+	    escaped = true;
+	  else if (('*' == ch) && !data.empty ())
+	    {
+	      // Run length encoded: the next char is the repeat count + 29
+	      ch = getChar ();
+	      if (-1 == ch)
+		return  false;
+
+	      checksum += (unsigned char) ch;
+	      data.append (ch - 29, data[data.size () - 1]);
+	    }
+	  else
+	    data += (char) ch;
+	}
+
+      int  hi = getChar ();
+      int  lo = getChar ();
+
+      if ((-1 == hi) || (-1 == lo))
+	return  false;
+
+      bool  ok = checksum == ((Utils::char2Hex (hi) << 4)
+			      | Utils::char2Hex (lo));
+
+      if (!mNoAckMode)
+	{
+	  char  ack = ok ? '+' : '-';
+
+	  if (!putBlock (&ack, 1))
+	    return  false;
+	}
+
+      if (ok || mNoAckMode)
+	return  true;
+    }
+}	// getPkt ()
+
+
+//! Send a break (ctrl-C) to the server
+
+//! @return  TRUE on success, FALSE if the connection has failed.
+
+bool
+ShmClient::sendBreak ()
+{
+  char  brk = 0x03;
+
+  return  putBlock (&brk, 1);
+
+}	// sendBreak ()
+
+
+//! Get the next char from the server, blocking if necessary
+
+//! @return  The char, or -1 if the connection has failed.
+
+int
+ShmClient::getChar ()
+{
+  if (nullptr == mRegion)
+    return  -1;
+
+  if (mRxPos == mRxLen)
+    {
+      mRxLen = shmRingRead (*mRegion, mRegion->toClient, mRegion->serverPid,
+			    mRxBuf, sizeof (mRxBuf));
+      mRxPos = 0;
+
+      if (mRxLen <= 0)
+	{
+	  mRxLen = 0;
+	  return  -1;
+	}
+    }
+
+  return  mRxBuf[mRxPos++] & 0xff;
+
+}	// getChar ()
+
+
+//! Write chars to the server, blocking if necessary
+
+//! @param[in] buf  The chars to write.
+//! @param[in] len  The number of chars to write.
+//! @return  TRUE on success, FALSE if the connection has failed.
+
+bool
+ShmClient::putBlock (const char *buf,
+		     int         len)
+{
+  if (nullptr == mRegion)
+    return  false;
+
+  return  shmRingWrite (*mRegion, mRegion->toServer, mRegion->serverPid, buf,
+			len);
+
+}	// putBlock ()
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
@@ -0,0 +1,91 @@
+// Shared memory RSP client: declaration
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SHM_CLIENT_H
+#define SHM_CLIENT_H
+
+#include <string>
+
+#include "ShmRing.h"
+
+//! Reference client for the shared memory RSP transport
+
+//! Lets a test harness talk to a server started with --shm, without GDB.
+//! Packets are framed, escaped and checksummed as GDB would, and
+//! acknowledgements are handled unless no-ack mode has been negotiated.
+
+class ShmClient
+{
+public:
+
+  // Constructor and destructor
+
+  ShmClient ();
+  ~ShmClient ();
+
+  // Attach to and detach from a server
+
+  bool  connect (const char *name);
+  void  disconnect ();
+
+  // Send and receive packets
+
+  bool  putPkt (const std::string &data);
+  bool  getPkt (std::string &data);
+  bool  sendBreak ();
+
+  // Turn acknowledgement of packets on or off (QStartNoAckMode)
+
+  void  setNoAckMode (bool  noAckMode);
+
+private:
+
+  //! How many times we wait for the server to start listening.
+
+  static const int CONNECT_TRIES = 50;
+
+  //! The mapped shared memory region, or nullptr if not connected.
+
+  ShmRegion *mRegion;
+
+  //! Have we negotiated QStartNoAckMode with the server?
+
+  bool  mNoAckMode;
+
+  //! Chars received but not yet consumed
+
+  char  mRxBuf[4096];
+  int   mRxLen;
+  int   mRxPos;
+
+  // Raw I/O
+
+  int   getChar ();
+  bool  putBlock (const char *buf,
+		  int         len);
+
+};	// ShmClient ()
+
+#endif	// SHM_CLIENT_H
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
@@ -0,0 +1,138 @@
+// Shared memory RSP reference client: main program.
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+#include "ShmClient.h"
+
+using std::cerr;
+using std::cin;
+using std::cout;
+using std::endl;
+using std::getline;
+using std::string;
+
+
+//! Get and print a reply
+
+//! Console output ('O' packets) from monitor commands is printed as it
+//! arrives, until the final reply.
+
+//! @param[in] client  The client to read from.
+//! @param[out] reply  The final reply.
+//! @return  TRUE on success, FALSE if the connection has failed.
+
+static bool
+printReply (ShmClient &client,
+	    string    &reply)
+{
+  do
+    {
+      if (!client.getPkt (reply))
+	{
+	  cerr << "ERROR: Failed to receive from server" << endl;
+	  return  false;
+	}
+
+      cout << reply << endl;
+    }
+  while (('O' == reply[0]) && ("OK" != reply));
+
+  return  true;
+
+}	// printReply ()
+
+
+//! Main function
+
+//! Attach to a server started with --shm <name>. Each line read from stdin
+//! is sent as a packet (without framing), and the reply printed on stdout.
+
+//! A line starting with '!' is sent without waiting for the reply, which is
+//! printed after the next line has been sent. A line of just "^C" sends a
+//! break. So "!c" followed by "^C" continues the target, interrupts it and
+//! prints the stop reply.
+
+//! @param[in] argc  Number of arguments.
+//! @param[in] argv  Vector or arguments.
+//! @return  The return code for the program.
+
+int
+main (int   argc,
+      char *argv[])
+{
+  if (argc != 2)
+    {
+      cerr << "Usage: rsp-shm-client <shm-name>" << endl;
+      return  EXIT_FAILURE;
+    }
+
+  ShmClient  client;
+
+  if (!client.connect (argv[1]))
+    return  EXIT_FAILURE;
+
+  string  line;
+  int     pending = 0;			// Replies not yet read
+
+  while (getline (cin, line))
+    {
+      bool  isBreak = "^C" == line;
+      bool  noWait  = !line.empty () && ('!' == line[0]);
+
+      if (noWait)
+	line.erase (0, 1);
+
+      bool  ok = isBreak ? client.sendBreak () : client.putPkt (line);
+
+      if (!ok)
+	{
+	  cerr << "ERROR: Failed to send to server" << endl;
+	  return  EXIT_FAILURE;
+	}
+
+      // A break has no reply of its own, nor does kill.
+      if (!isBreak && ("k" != line))
+	pending++;
+
+      if (noWait)
+	continue;
+
+      string  reply;
+
+      for (; pending > 0; pending--)
+	if (!printReply (client, reply))
+	  return  EXIT_FAILURE;
+
+      if (("QStartNoAckMode" == line) && ("OK" == reply))
+	client.setNoAckMode (true);
+    }
+
+  return  EXIT_SUCCESS;
+
+}	// main ()
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
@@ -0,0 +1,272 @@
+// Shared memory RSP connection: implementation
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+#include <new>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ShmConnection.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::flush;
+
+
+//! Constructor when using a shared memory object
+
+//! Sets up various parameters. The region itself is created on the first
+//! call to rspConnect ().
+
+//! @param[in] _shmName     the name of the POSIX shared memory object
+//! @param[in] _traceFlags  flags controlling tracing
+ShmConnection::ShmConnection (const char *_shmName,
+			      TraceFlags *_traceFlags) :
+  AbstractConnection (_traceFlags),
+  shmName (_shmName),
+  mRegion (nullptr),
+  mIsConnected (false)
+{
+  // POSIX requires the name to start with '/'.
+  if ('/' != shmName[0])
+    shmName.insert (0, "/");
+
+}	// ShmConnection ()
+
+
+//! Destructor
+
+//! Close the connection if it is still open, then unmap and remove the
+//! shared memory object.
+ShmConnection::~ShmConnection ()
+{
+  this->rspClose ();		// Don't confuse with any other close ()
+
+  if (nullptr != mRegion)
+    {
+      munmap (mRegion, sizeof (*mRegion));
+      shm_unlink (shmName.c_str ());
+    }
+}	// ~ShmConnection ()
+
+
+//! Create and map the shared memory region.
+
+//! Any stale object of the same name is removed first.
+
+//! @return  TRUE if the region was created, FALSE otherwise.
+bool
+ShmConnection::createRegion ()
+{
+  shm_unlink (shmName.c_str ());
+
+  int  fd = shm_open (shmName.c_str (), O_CREAT | O_EXCL | O_RDWR, 0600);
+
+  if (fd < 0)
+    {
+      cerr << "ERROR: Cannot create RSP shared memory " << shmName << ": "
+	   << strerror (errno) << endl;
+      return  false;
+    }
+
+  if (ftruncate (fd, sizeof (ShmRegion)) != 0)
+    {
+      cerr << "ERROR: Cannot size RSP shared memory: " << strerror (errno)
+	   << endl;
+      close (fd);
+      return  false;
+    }
+
+  void *addr = mmap (nullptr, sizeof (ShmRegion), PROT_READ | PROT_WRITE,
+		     MAP_SHARED, fd, 0);
+  close (fd);				// Mapping keeps the object alive
+
+  if (MAP_FAILED == addr)
+    {
+      cerr << "ERROR: Cannot map RSP shared memory: " << strerror (errno)
+	   << endl;
+      return  false;
+    }
+
+  // The object is zero filled, which is a valid initial state for all the
+  // atomics, but for portability we construct the region properly.
+  mRegion = new (addr) ShmRegion;
+  return  true;
+
+}	// createRegion ()
+
+
+//! Get a new client connection.
+
+//! Blocks until a client attaches to the shared memory region, by changing
+//! its state from LISTENING to CONNECTED.
+
+//! @return  TRUE if the connection was established or can be retried. FALSE
+//!          if the error was so serious the program must be aborted.
+bool
+ShmConnection::rspConnect ()
+{
+  if ((nullptr == mRegion) && !createRegion ())
+    return  false;
+
+  // Make the region ready for a new client. The magic number is written
+  // last, so a client never sees a half initialized region.
+  mRegion->magic.store (0);
+  mRegion->toServer.reset ();
+  mRegion->toClient.reset ();
+  mRegion->clientPid.store (0);
+  mRegion->serverPid.store (getpid ());
+  mRegion->state.store (ShmRegion::LISTENING);
+  mRegion->magic.store (ShmRegion::MAGIC);
+
+  if (! traceFlags->traceSilent ())
+    cout << "Listening for RSP on shared memory " << shmName << endl
+	 << flush;
+
+  while (ShmRegion::LISTENING == mRegion->state.load ())
+    shmFutexWait (mRegion->state, ShmRegion::LISTENING);
+
+  if (ShmRegion::CONNECTED != mRegion->state.load ())
+    return  true;			// OK to retry
+
+  mIsConnected = true;
+
+  if (! traceFlags->traceSilent ())
+    cout << "Remote debugging from process " << mRegion->clientPid.load ()
+	 << endl;
+
+  startReader ();
+  return  true;
+
+}	// rspConnect ()
+
+
+//! Close a client connection if it is open
+
+//! Marking the region closed makes both the reader thread and the client
+//! give up any wait.
+void
+ShmConnection::rspClose ()
+{
+  if (isConnected ())
+    {
+      if (! traceFlags->traceSilent ())
+	cout << "Closing connection" << endl;
+
+      mRegion->state.store (ShmRegion::CLOSED);
+      shmFutexWake (mRegion->state);
+      shmFutexWake (mRegion->toServer.tail);
+      shmFutexWake (mRegion->toClient.head);
+      stopReader ();
+      mIsConnected = false;
+    }
+}	// rspClose ()
+
+
+//! Report if we are connected to a client.
+
+//! @return  TRUE if we are connected, FALSE otherwise
+bool
+ShmConnection::isConnected ()
+{
+  return  mIsConnected;
+
+}	// isConnected ()
+
+
+//! Put a single character out on the RSP connection
+
+//! @param[in] c  The character to put out
+
+//! @return  TRUE if char sent OK, FALSE if not (communications failure)
+
+bool
+ShmConnection::putRspCharRaw (char  c)
+{
+  return  putRspBlockRaw (&c, 1);
+
+}	// putRspCharRaw ()
+
+
+//! Put a block of characters out on the RSP connection
+
+//! Utility routine. This should only be called if the client is open, but we
+//! check for safety.
+
+//! @param[in] buf  The characters to put out
+//! @param[in] len  The number of characters to put out
+
+//! @return  TRUE if all chars sent OK, FALSE if not (communications failure)
+
+bool
+ShmConnection::putRspBlockRaw (const char *buf,
+			       int         len)
+{
+  if (!mIsConnected)
+    {
+      cerr << "Warning: Attempt to write " << len
+	   << " chars to unopened RSP client: Ignored" << endl;
+      return  false;
+    }
+
+  if (!shmRingWrite (*mRegion, mRegion->toClient, mRegion->clientPid, buf,
+		     len))
+    {
+      cerr << "Warning: Failed to write to RSP client: "
+	   << "Closing client connection" << endl;
+      return  false;
+    }
+
+  return  true;
+
+}	// putRspBlockRaw ()
+
+
+//! Get a block of characters from the RSP connection
+
+//! Utility routine, only called from the reader thread. Blocks until at
+//! least one character is available.
+
+//! @param[out] buf     Buffer for the characters received.
+//! @param[in]  maxLen  Size of the buffer.
+//! @return  The number of characters received, or -1 on failure or when the
+//!          connection is closed.
+
+int
+ShmConnection::getRspBlockRaw (char *buf,
+			       int   maxLen)
+{
+  return  shmRingRead (*mRegion, mRegion->toServer, mRegion->clientPid, buf,
+		       maxLen);
+
+}	// getRspBlockRaw ()
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
@@ -0,0 +1,91 @@
+// Shared memory RSP connection: declaration
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SHM_CONNECTION_H
+#define SHM_CONNECTION_H
+
+#include <string>
+
+#include "AbstractConnection.h"
+#include "ShmRing.h"
+#include "TraceFlags.h"
+
+//! Class implementing the RSP connection over shared memory
+
+//! For use by a test harness on the same host, where even a pipe adds
+//! noticeable latency to each packet.  The server creates a POSIX shared
+//! memory object holding a ShmRegion, with one ring in each direction.
+//! Sleeping and waking is done with futexes on the ring indices.
+
+//! Only the raw I/O is different, so RSP framing is still done by
+//! AbstractConnection::getPkt () and AbstractConnection::putPkt ().  See
+//! ShmClient for the other end.
+
+class ShmConnection : public AbstractConnection
+{
+public:
+
+  // Constructors and destructor
+
+  ShmConnection (const char *_shmName,
+		 TraceFlags *_traceFlags);
+  ~ShmConnection ();
+
+  // Public interface: manage client connections
+
+  bool  rspConnect ();
+  void  rspClose ();
+  bool  isConnected ();
+
+private:
+
+  //! The name of the shared memory object
+
+  std::string  shmName;
+
+  //! The mapped shared memory region, or nullptr if not yet created.
+
+  ShmRegion *mRegion;
+
+  //! Are we connected to a client?
+
+  bool  mIsConnected;
+
+  // Implementation specific routines to handle individual chars and blocks
+  // of chars.
+
+  virtual bool  putRspCharRaw (char  c);
+  virtual bool  putRspBlockRaw (const char *buf,
+				int         len);
+  virtual int   getRspBlockRaw (char *buf,
+				int   maxLen);
+
+  // Create the shared memory region
+
+  bool  createRegion ();
+
+};	// ShmConnection ()
+
+#endif	// SHM_CONNECTION_H
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
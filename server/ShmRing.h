@@ -0,0 +1,294 @@
+// Shared memory RSP transport: layout shared by server and client
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+
+//! A single producer, single consumer byte ring in shared memory.
+
+//! The head and tail are free running indices. Only the consumer writes the
+//! head and only the producer writes the tail. The indices double as futex
+//! words, so a consumer can sleep until the tail moves, and a producer until
+//! the head moves.  The waiters count means we only pay for a futex wake
+//! when someone is actually asleep.
+
+struct ShmRing
+{
+  //! Size of the data area. Must be a power of 2.
+
+  static const uint32_t SIZE = 65536;
+
+  std::atomic<uint32_t>  head;
+  std::atomic<uint32_t>  tail;
+  std::atomic<uint32_t>  waiters;
+  char                   data[SIZE];
+
+  //! Empty the ring. Only safe when neither end is using it.
+
+  void
+  reset ()
+  {
+    head.store (0);
+    tail.store (0);
+    waiters.store (0);
+  }
+
+  //! Take as many chars as are available, up to maxLen, without blocking.
+
+  //! @return  The number of chars taken.
+
+  int
+  get (char *buf,
+       int   maxLen)
+  {
+    uint32_t  h     = head.load (std::memory_order_relaxed);
+    uint32_t  avail = tail.load (std::memory_order_acquire) - h;
+    uint32_t  n     = avail < (uint32_t) maxLen ? avail : maxLen;
+    uint32_t  off   = h & (SIZE - 1);
+    uint32_t  first = n < SIZE - off ? n : SIZE - off;
+
+    memcpy (buf, &(data[off]), first);
+    memcpy (buf + first, data, n - first);
+    head.store (h + n, std::memory_order_release);
+    return  n;
+  }
+
+  //! Add as many chars as will fit, up to len, without blocking.
+
+  //! @return  The number of chars added.
+
+  int
+  put (const char *buf,
+       int         len)
+  {
+    uint32_t  t     = tail.load (std::memory_order_relaxed);
+    uint32_t  space = SIZE - (t - head.load (std::memory_order_acquire));
+    uint32_t  n     = space < (uint32_t) len ? space : len;
+    uint32_t  off   = t & (SIZE - 1);
+    uint32_t  first = n < SIZE - off ? n : SIZE - off;
+
+    memcpy (&(data[off]), buf, first);
+    memcpy (data, buf + first, n - first);
+    tail.store (t + n, std::memory_order_release);
+    return  n;
+  }
+};	// ShmRing
+
+
+//! The complete shared memory region.
+
+//! The server creates and initializes the region, then waits for the state
+//! to change from LISTENING to CONNECTED, which the client does when it
+//! attaches.  Either end closes the connection by setting the state to
+//! CLOSED.  Each end records its process ID, so a peer which dies without
+//! closing can be spotted.
+
+struct ShmRegion
+{
+  //! Identifies a valid region, written last by the server.
+
+  static const uint32_t MAGIC = 0x52535030;	// "RSP0"
+
+  //! Connection states
+
+  static const uint32_t LISTENING = 0;
+  static const uint32_t CONNECTED = 1;
+  static const uint32_t CLOSED    = 2;
+
+  std::atomic<uint32_t>  magic;
+  std::atomic<uint32_t>  state;
+  std::atomic<int32_t>   serverPid;
+  std::atomic<int32_t>   clientPid;
+  ShmRing                toServer;
+  ShmRing                toClient;
+};	// ShmRegion
+
+
+//! How long we sleep on a futex before checking the peer is still alive.
+
+static const long SHM_POLL_NSEC = 100 * 1000 * 1000;
+
+
+//! Sleep while a shared word still has an expected value.
+
+//! May return early for any reason, so callers must recheck their
+//! condition.
+
+//! @param[in] word      The word to wait on.
+//! @param[in] expected  The value to wait for the word to change from.
+
+static inline void
+shmFutexWait (std::atomic<uint32_t> &word,
+	      uint32_t               expected)
+{
+  struct timespec  ts = { 0, SHM_POLL_NSEC };
+
+  (void) syscall (SYS_futex, reinterpret_cast<uint32_t *> (&word),
+		  FUTEX_WAIT, expected, &ts, nullptr, 0);
+}	// shmFutexWait ()
+
+
+//! Wake everyone sleeping on a shared word.
+
+//! @param[in] word  The word to wake sleepers on.
+
+static inline void
+shmFutexWake (std::atomic<uint32_t> &word)
+{
+  (void) syscall (SYS_futex, reinterpret_cast<uint32_t *> (&word),
+		  FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}	// shmFutexWake ()
+
+
+//! Is the process at the other end still there?
+
+//! @param[in] pid  The process ID of the peer.
+//! @return  TRUE if the process exists, FALSE otherwise.
+
+static inline bool
+shmPeerAlive (int32_t  pid)
+{
+  return  (0 == pid) || (0 == kill (pid, 0)) || (EPERM == errno);
+
+}	// shmPeerAlive ()
+
+
+//! Blocking read from a ring.
+
+//! Waits until at least one char is available. Gives up if the connection
+//! is no longer CONNECTED (or the peer has died) and the ring is empty.
+
+//! @param[in]  region   The shared region.
+//! @param[in]  ring     The ring to read from.
+//! @param[in]  peerPid  The process ID of the writer.
+//! @param[out] buf      Where to put the chars.
+//! @param[in]  maxLen   Size of buf.
+//! @return  The number of chars read, or -1 if the connection has gone.
+
+static inline int
+shmRingRead (ShmRegion             &region,
+	     ShmRing               &ring,
+	     std::atomic<int32_t>  &peerPid,
+	     char                  *buf,
+	     int                    maxLen)
+{
+  for (;;)
+    {
+      int  n = ring.get (buf, maxLen);
+
+      if (n > 0)
+	{
+	  // The new head must be visible before we look for waiters, or a
+	  // writer which has just gone to sleep on the old head is missed.
+	  std::atomic_thread_fence (std::memory_order_seq_cst);
+
+	  if (ring.waiters.load (std::memory_order_seq_cst) != 0)
+	    shmFutexWake (ring.head);
+
+	  return  n;
+	}
+
+      if ((ShmRegion::CONNECTED != region.state.load ())
+	  || !shmPeerAlive (peerPid.load ()))
+	return  -1;
+
+      uint32_t  t = ring.tail.load (std::memory_order_acquire);
+
+      ring.waiters.fetch_add (1);
+      if (t == ring.head.load (std::memory_order_seq_cst))
+	shmFutexWait (ring.tail, t);
+      ring.waiters.fetch_sub (1);
+    }
+}	// shmRingRead ()
+
+
+//! Blocking write to a ring.
+
+//! Waits until all the chars have been added. Gives up if the connection is
+//! no longer CONNECTED (or the peer has died).
+
+//! @param[in] region   The shared region.
+//! @param[in] ring     The ring to write to.
+//! @param[in] peerPid  The process ID of the reader.
+//! @param[in] buf      The chars to write.
+//! @param[in] len      The number of chars to write.
+//! @return  TRUE if all the chars were written, FALSE otherwise.
+
+static inline bool
+shmRingWrite (ShmRegion             &region,
+	      ShmRing               &ring,
+	      std::atomic<int32_t>  &peerPid,
+	      const char            *buf,
+	      int                    len)
+{
+  while (len > 0)
+    {
+      if ((ShmRegion::CONNECTED != region.state.load ())
+	  || !shmPeerAlive (peerPid.load ()))
+	return  false;
+
+      int  n = ring.put (buf, len);
+
+      if (n > 0)
+	{
+	  buf += n;
+	  len -= n;
+
+	  // The new tail must be visible before we look for waiters, or a
+	  // reader which has just gone to sleep on the old tail is missed.
+	  std::atomic_thread_fence (std::memory_order_seq_cst);
+
+	  if (ring.waiters.load (std::memory_order_seq_cst) != 0)
+	    shmFutexWake (ring.tail);
+
+	  continue;
+	}
+
+      uint32_t  h = ring.head.load (std::memory_order_acquire);
+
+      ring.waiters.fetch_add (1);
+      if (ring.tail.load (std::memory_order_seq_cst) - h == ShmRing::SIZE)
+	shmFutexWait (ring.head, h);
+      ring.waiters.fetch_sub (1);
+    }
+
+  return  true;
+
+}	// shmRingWrite ()
+
+#endif	// SHM_RING_H
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
@@ -25,7 +25,7 @@
 #include <csignal>
 #include <cstring>
 
-#include <sys/select.h>
+#include <poll.h>
 #include <unistd.h>
 
 #include "StreamConnection.h"
@@ -51,7 +51,16 @@ StreamConnection::StreamConnection (TraceFlags *_traceFlags) :
   AbstractConnection (_traceFlags),
   mIsConnected (true)
 {
-  // Nothing.
+  if (pipe (mWakeFds) != 0)
+    {
+      cerr << "Warning: Failed to create wake up pipe: " << strerror (errno)
+	   << endl;
+      mWakeFds[0] = -1;
+      mWakeFds[1] = -1;
+    }
+
+  startReader ();
+
 }	// StreamConnection ()
 
 
@@ -61,6 +70,12 @@ StreamConnection::StreamConnection (TraceFlags *_traceFlags) :
 StreamConnection::~StreamConnection ()
 {
   this->rspClose ();		// Don't confuse with any other close ()
+
+  if (mWakeFds[0] != -1)
+    {
+      close (mWakeFds[0]);
+      close (mWakeFds[1]);
+    }
 }	// ~StreamConnection ()
 
 
@@ -97,10 +112,22 @@ StreamConnection::rspConnect ()
 
 //! Close a client connection if it is open.  This is called once we detect
 //! that stdin might have closed.  Remember we're now in a closed state.
+
+//! The reader thread may still be blocked on stdin, so we wake it through
+//! the pipe before stopping it.
 void
 StreamConnection::rspClose ()
 {
-  mIsConnected = false;
+  if (mIsConnected)
+    {
+      char  c = 0;
+
+      if ((mWakeFds[1] != -1) && (write (mWakeFds[1], &c, 1) != 1))
+	cerr << "Warning: Failed to wake RSP reader" << endl;
+
+      stopReader ();
+      mIsConnected = false;
+    }
 }	// rspClose ()
 
 
@@ -153,39 +180,80 @@ StreamConnection::putRspCharRaw (char  c)
 }	// putRspCharRaw ()
 
 
-//! Get a single character from the RSP connection
+//! Put a block of characters out on the RSP connection
 
-//! Utility routine. This should only be called if the client is open, but we
-//! check for safety.
+//! Utility routine. We keep writing until the whole block has gone, since a
+//! write may only take part of it.
+
+//! @param[in] buf  The characters to put out
+//! @param[in] len  The number of characters to put out
 
-//! @param[in] blocking  True if the read should block.
-//! @return  The character received or -1 on failure, or if the read would
-//!          block, and blocking is true.
+//! @return  TRUE if all chars sent OK, FALSE if not (communications failure)
+
+bool
+StreamConnection::putRspBlockRaw (const char *buf,
+				  int         len)
+{
+  // Write until everything is sent (we retry after interrupts) or
+  // catastrophic failure.
+  while (len > 0)
+    {
+      ssize_t  count = write (STDOUT_FILENO, buf, len);
+
+      switch (count)
+	{
+	case -1:
+	  // Error: only allow interrupts or would block
+	  if ((EAGAIN != errno) && (EINTR != errno))
+	    {
+	      cerr << "Warning: Failed to write to RSP client: "
+			<< "Closing client connection: "
+			<<  strerror (errno) << endl;
+	      return  false;
+	    }
+
+	  break;
+
+	default:
+	  buf += count;		// Partial success, carry on
+	  len -= count;
+	  break;
+	}
+    }
+
+  return  true;
+
+}	// putRspBlockRaw ()
+
+
+//! Get a block of characters from the RSP connection
+
+//! Utility routine, only called from the reader thread. A single blocking
+//! read gets as many characters as are available, up to the size of the
+//! buffer. We also watch the wake up pipe, so we can be told to give up.
+
+//! @param[out] buf     Buffer for the characters received.
+//! @param[in]  maxLen  Size of the buffer.
+//! @return  The number of characters received, or -1 on failure or when the
+//!          connection is closed.
 
 int
-StreamConnection::getRspCharRaw (bool blocking)
+StreamConnection::getRspBlockRaw (char *buf,
+				  int   maxLen)
 {
   // Blocking read until successful (we retry after interrupts) or
   // catastrophic failure.
 
   for (;;)
     {
-      unsigned char  c;
-      int res;
-      struct timeval timeout;
-      fd_set readfds;
-
-      timeout.tv_sec = 0;
-      timeout.tv_usec = 0;
+      struct pollfd  fds[2];
 
-      FD_ZERO (&readfds);
-      FD_SET (STDIN_FILENO, &readfds);
+      fds[0].fd     = STDIN_FILENO;
+      fds[0].events = POLLIN;
+      fds[1].fd     = mWakeFds[0];
+      fds[1].events = POLLIN;
 
-      res = select (STDIN_FILENO + 1,
-                    &readfds, NULL, NULL,
-                    (blocking ? NULL : &timeout));
-
-      switch (res)
+      switch (poll (fds, 2, -1))
   	{
   	case -1:
   	  // Error: only allow interrupts
@@ -200,24 +268,26 @@ StreamConnection::getRspCharRaw (bool blocking)
   	  break;
 
   	case 0:
-          // Timeout, only happens in the blocking case.
-  	  return  -1;
+  	  break;		// Can't happen with no timeout
 
   	default:
 	  {
+	    if (fds[1].revents != 0)
+	      return  -1;		// We are closing
+
 	    ssize_t count;
 
-	    if ((count = read (STDIN_FILENO, &c, sizeof (c))) == -1)
+	    if ((count = read (STDIN_FILENO, buf, maxLen)) == -1)
 	      return -1;
 
 	    if (count == 0)
 	      return -1;
 
-	    return  c & 0xff;	// Success, we can return (no sign extend!)
+	    return  count;	// Success, we can return
 	  }
   	}
     }
-}	// getRspCharRaw ()
+}	// getRspBlockRaw ()
 
 
 // Local Variables:
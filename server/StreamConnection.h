@@ -25,8 +25,8 @@
 
 //! Class implementing the RSP connection listener
 
-//! This class is entirely passive. It is up to the caller to determine
-//! that a packet will become available before calling ::getPkt ().
+//! The client talks to us through stdin and stdout, which are connected
+//! from the start.
 
 class StreamConnection : public AbstractConnection
 {
@@ -45,13 +45,21 @@ public:
 
 private:
 
-  // Implementation specific routines to handle individual chars.
+  // Implementation specific routines to handle individual chars and blocks
+  // of chars.
 
   virtual bool  putRspCharRaw (char  c);
-  virtual int   getRspCharRaw (bool blocking);
+  virtual bool  putRspBlockRaw (const char *buf,
+				int         len);
+  virtual int   getRspBlockRaw (char *buf,
+				int   maxLen);
 
   // Track whether we are connected or not.
   bool mIsConnected;
+
+  //! Pipe used to wake the reader thread when we close, since there is no
+  //! way to shut down stdin.
+  int mWakeFds[2];
 };	// StreamConnection ()
 
 #endif	// STREAM_CONNECTION_H
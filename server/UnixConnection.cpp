@@ -0,0 +1,169 @@
+// Unix domain socket RSP connection: implementation
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "UnixConnection.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::flush;
+
+
+//! Constructor when using a socket path
+
+//! Sets up various parameters
+
+//! @param[in] _sockPath    the filesystem path of the socket
+//! @param[in] _traceFlags  flags controlling tracing
+UnixConnection::UnixConnection (const char *_sockPath,
+				TraceFlags *_traceFlags) :
+  FdConnection (_traceFlags),
+  sockPath (_sockPath),
+  listenFd (-1)
+{
+
+}	// UnixConnection ()
+
+
+//! Destructor
+
+//! Close the connection if it is still open, stop listening and remove the
+//! socket from the filesystem.
+UnixConnection::~UnixConnection ()
+{
+  this->rspClose ();		// Don't confuse with any other close ()
+
+  if (listenFd >= 0)
+    {
+      close (listenFd);
+      unlink (sockPath.c_str ());
+    }
+
+}	// ~UnixConnection ()
+
+
+//! Get a new client connection.
+
+//! Blocks until the client connection is available.
+
+//! This mirrors RspConnection::rspConnect (), but listens on a Unix domain
+//! socket at the given path.  As there, the listening socket is kept open
+//! between clients.
+
+//! @return  TRUE if the connection was established or can be retried. FALSE
+//!          if the error was so serious the program must be aborted.
+bool
+UnixConnection::rspConnect ()
+{
+  // Open the socket on which we'll listen for clients, if not already open
+  if ((listenFd < 0) && !listenOn ())
+    return  false;
+
+  if (! traceFlags->traceSilent ())
+    cout << "Listening for RSP on socket " << sockPath << endl << flush;
+
+  // Accept a client which connects
+  clientFd = accept (listenFd, nullptr, nullptr);
+
+  if (-1 == clientFd)
+    {
+      cerr << "Warning: Failed to accept RSP client: " << strerror (errno)
+	   << endl;
+      return  true;			// OK to retry
+    }
+
+  signal (SIGPIPE, SIG_IGN);		// So we don't exit if client dies
+
+  if (! traceFlags->traceSilent ())
+    cout << "Remote debugging on socket " << sockPath << endl;
+
+  startReader ();
+  return true;
+
+}	// rspConnect ()
+
+
+//! Create the socket listening for clients
+
+//! Any stale socket left at our path (for example by a previous server which
+//! was killed) is removed first.
+
+//! @return  TRUE if we are now listening, FALSE otherwise.
+bool
+UnixConnection::listenOn ()
+{
+  struct sockaddr_un  sockAddr;
+
+  if (sockPath.size () >= sizeof (sockAddr.sun_path))
+    {
+      cerr << "ERROR: RSP socket path too long: " << sockPath << endl;
+      return  false;
+    }
+
+  int  tmpFd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (tmpFd < 0)
+    {
+      cerr << "ERROR: Cannot open RSP socket" << endl;
+      return  false;
+    }
+
+  // Bind the path to the socket
+  memset (&sockAddr, 0, sizeof (sockAddr));
+  sockAddr.sun_family = AF_UNIX;
+  strncpy (sockAddr.sun_path, sockPath.c_str (),
+	   sizeof (sockAddr.sun_path) - 1);
+
+  unlink (sockPath.c_str ());
+
+  if (bind (tmpFd, (struct sockaddr *) &sockAddr, sizeof (sockAddr)))
+    {
+      cerr << "ERROR: Cannot bind to RSP socket " << sockPath << ": "
+	   << strerror (errno) << endl;
+      close (tmpFd);
+      return  false;
+    }
+
+  if (listen (tmpFd, SOMAXCONN))
+    {
+      cerr << "ERROR: Cannot listen on RSP socket" << endl;
+      close (tmpFd);
+      return  false;
+    }
+
+  listenFd = tmpFd;
+  return  true;
+
+}	// listenOn ()
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
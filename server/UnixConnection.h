@@ -0,0 +1,71 @@
+// Unix domain socket RSP connection: declaration
+
+// Copyright (C) 2017  Embecosm Limited <info@embecosm.com>
+
+// This file is part of the RISC-V GDB server
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef UNIX_CONNECTION_H
+#define UNIX_CONNECTION_H
+
+#include <string>
+
+#include "FdConnection.h"
+#include "TraceFlags.h"
+
+//! Class implementing the RSP connection over a Unix domain socket
+
+//! For use when GDB and the server are on the same host.  This avoids the
+//! TCP stack, and there is no need to allocate a port number for each
+//! server.  Otherwise this behaves just like RspConnection.
+
+class UnixConnection : public FdConnection
+{
+public:
+
+  // Constructors and destructor
+
+  UnixConnection (const char *_sockPath,
+		  TraceFlags *_traceFlags);
+  ~UnixConnection ();
+
+  // Public interface: manage client connections
+
+  bool  rspConnect ();
+
+private:
+
+  //! The filesystem path of the socket to listen on
+
+  std::string  sockPath;
+
+  //! The socket listening for clients, or -1 if not yet listening.  Kept
+  //! open between clients.
+
+  int  listenFd;
+
+  // Create the listening socket
+
+  bool  listenOn ();
+
+};	// UnixConnection ()
+
+#endif	// UNIX_CONNECTION_H
+
+
+// Local Variables:
+// mode: C++
+// c-file-style: "gnu"
+// End:
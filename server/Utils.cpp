@@ -216,45 +216,6 @@ Utils::hex2Ascii (char *dest,
 }	// hex2ascii ()
 
 
-//! "Unescape" RSP binary data
-
-//! '#', '$' and '}' are escaped by preceding them by '}' and oring with 0x20.
-
-//! This function reverses that, modifying the data in place.
-
-//! @param[in] buf  The array of bytes to convert
-//! @para[in]  len   The number of bytes to be converted
-
-//! @return  The number of bytes AFTER conversion
-int
-Utils::rspUnescape (char *buf,
-		    int   len)
-{
-  int  fromOffset = 0;		// Offset to source char
-  int  toOffset   = 0;		// Offset to dest char
-
-  while (fromOffset < len)
-    {
-      // Is it escaped
-      if ( '}' == buf[fromOffset])
-	{
-	  fromOffset++;
-	  buf[toOffset] = buf[fromOffset] ^ 0x20;
-	}
-      else
-	{
-	  buf[toOffset] = buf[fromOffset];
-	}
-
-      fromOffset++;
-      toOffset++;
-    }
-
-  return  toOffset;
-
-}	// rspUnescape () */
-
-
 //! Split a string into delimited tokens
 
 //! @param[in]  s      The string of tokes
@@ -288,3 +249,70 @@ Utils::split (const string        & s,
   return elems;
 
 }	// split ()
+
+
+//! Compute the CRC-32 of a buffer, as GDB does for qCRC
+
+//! This is the CRC GDB uses to compare sections (xcrc32 in libiberty), with
+//! polynomial 0x04c11db7, taking the most significant bit first, seeded with
+//! all ones and not inverted at the end. So it is not the same as the CRC-32
+//! used by zlib.
+
+//! Eight bytes are done at a time, by looking up each in its own table
+//! ("slicing by 8"). The tables are built on first use.
+
+//! @param[in] buf  The data.
+//! @param[in] len  Its length.
+//! @param[in] crc  The CRC so far, to continue from. Defaults to the seed
+//!                 for a new CRC.
+//! @return  The CRC including the data.
+
+uint32_t
+Utils::crc32 (const uint8_t *buf,
+	      std::size_t    len,
+	      uint32_t       crc)
+{
+  static const struct Tables
+  {
+    uint32_t  t[8][256];
+
+    Tables ()
+    {
+      for (uint32_t  i = 0; i < 256; i++)
+	{
+	  uint32_t  c = i << 24;
+
+	  for (int  bit = 0; bit < 8; bit++)
+	    c = (c & 0x80000000) ? (c << 1) ^ 0x04c11db7 : c << 1;
+
+	  t[0][i] = c;
+	}
+
+      // Each further table is for a byte followed by one more zero byte.
+      for (int  k = 1; k < 8; k++)
+	for (uint32_t  i = 0; i < 256; i++)
+	  t[k][i] = (t[k - 1][i] << 8) ^ t[0][t[k - 1][i] >> 24];
+    }
+  } tables;
+
+  const uint32_t (*t)[256] = tables.t;
+
+  for (; len >= 8; buf += 8, len -= 8)
+    {
+      uint32_t  hi = crc ^ (((uint32_t) buf[0] << 24) | (buf[1] << 16)
+			    | (buf[2] << 8) | buf[3]);
+      uint32_t  lo = ((uint32_t) buf[4] << 24) | (buf[5] << 16)
+	| (buf[6] << 8) | buf[7];
+
+      crc = t[7][hi >> 24] ^ t[6][(hi >> 16) & 0xff]
+	^ t[5][(hi >> 8) & 0xff] ^ t[4][hi & 0xff]
+	^ t[3][lo >> 24] ^ t[2][(lo >> 16) & 0xff]
+	^ t[1][(lo >> 8) & 0xff] ^ t[0][lo & 0xff];
+    }
+
+  for (; len > 0; buf++, len--)
+    crc = (crc << 8) ^ t[0][((crc >> 24) ^ *buf) & 0xff];
+
+  return  crc;
+
+}	// crc32 ()
@@ -23,6 +23,7 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -48,8 +49,9 @@ public:
 				char *src);
   static void        hex2Ascii (char *dest,
 				char *src);
-  static int         rspUnescape (char *buf,
-				  int   len);
+  static uint32_t    crc32 (const uint8_t *buf,
+			    std::size_t    len,
+			    uint32_t       crc = 0xffffffff);
   static std::vector<std::string> & split (const std::string & s,
   					   const std::string & delim,
   					   std::vector<std::string> & elems);
@@ -51,7 +51,10 @@
 #include "TraceFlags.h"
 
 #include "RspConnection.h"
+#include "SessionManager.h"
+#include "ShmConnection.h"
 #include "StreamConnection.h"
+#include "UnixConnection.h"
 
 using std::atoi;
 using std::cerr;
@@ -65,6 +68,11 @@ using std::strcmp;
 
 static ITarget *globalCpu = nullptr;
 
+//! The RISC-V model for this thread, used for $time.  With --sessions each
+//! worker thread has its own model.
+
+static thread_local ITarget *threadCpu = nullptr;
+
 static const std::string gdbserver_name =
 #ifdef BUILD_64_BIT
     "riscv64-gdbserver"
@@ -84,16 +92,39 @@ usage (ostream & s)
     << "                         [ --trace | -t <traceflag> ]" << endl
     << "                         [ --silent | -q ]" << endl
     << "                         [ --stdin | -s ]" << endl
+    << "                         [ --socket | -u <socket-path> ]" << endl
+    << "                         [ --shm | -m <shm-name> ]" << endl
+    << "                         [ --sessions | -S <workers> ]" << endl
+    << "                         [ --flash | -f <start>,<length> ]" << endl
     << "                         [ --help | -h ]" << endl
     << "                         [ --version | -v ]" << endl
     << "                         <rsp-port>" << endl
     << endl
+    << "The RSP port is not needed with --stdin, --socket or --shm." << endl
+    << endl
+    << "With --sessions, each client connecting to the RSP port gets its own"
+    << endl
+    << "core, and up to <workers> clients are served at once. Verilator"
+    << endl
+    << "cores take turns to clock their models, so they do not simulate in"
+    << endl
+    << "parallel." << endl
+    << endl
+    << "With --flash, GDB is told the given region of memory is flash, so it"
+    << endl
+    << "loads programs there in large blocks with vFlash packets. GDB will"
+    << endl
+    << "not otherwise write to the region, so it should only hold code and"
+    << endl
+    << "read only data." << endl
+    << endl
     << "The trace option may appear multiple times. Trace flags are:" << endl
     << "  rsp     Trace RSP packets" << endl
     << "  conn    Trace RSP connection handling" << endl
     << "  break   Trace breakpoint handling" << endl
     << "  vcd     Generate a Verilog Change Dump" << endl
-    << "  silent  Minimize informative messages (synonym for -q)" << endl;
+    << "  silent  Minimize informative messages (synonym for -q)" << endl
+    << "  stats   Report RSP packet statistics on exit" << endl;
 
 }	// usage ()
 
@@ -165,7 +196,12 @@ main (int   argc,
 
   char         *coreName = nullptr;
   bool          from_stdin = false;
+  char         *sockPath = nullptr;
+  char         *shmName = nullptr;
   int           port = -1;
+  int           numWorkers = 0;
+  uint32_t      flashStart = 0;
+  uint32_t      flashLength = 0;
   TraceFlags *  traceFlags = new TraceFlags ();
   int           nextArg;
 
@@ -178,11 +214,15 @@ main (int   argc,
       {"silent", no_argument,       nullptr,  'q' },
       {"trace",  required_argument, nullptr,  't' },
       {"stdin",  no_argument,       nullptr,  's' },
+      {"socket", required_argument, nullptr,  'u' },
+      {"shm",    required_argument, nullptr,  'm' },
+      {"sessions", required_argument, nullptr, 'S' },
+      {"flash",  required_argument, nullptr,  'f' },
       {"version", no_argument,      nullptr,  'v' },
       {0,       0,                 0,  0 }
     };
 
-    if ((c = getopt_long (argc, argv, "c:hqt:sv", longOptions, &longOptind)) == -1)
+    if ((c = getopt_long (argc, argv, "c:hqt:su:m:S:f:v", longOptions, &longOptind)) == -1)
       break;
 
     switch (c) {
@@ -215,6 +255,45 @@ main (int   argc,
       from_stdin = true;
       break;
 
+    case 'u':
+      sockPath = strdup (optarg);
+      break;
+
+    case 'm':
+      shmName = strdup (optarg);
+      break;
+
+    case 'S':
+      numWorkers = atoi (optarg);
+
+      if (numWorkers < 1)
+	{
+	  cerr << "ERROR: Bad number of session workers " << optarg << endl;
+	  usage (cerr);
+	  return EXIT_FAILURE;
+	}
+
+      break;
+
+    case 'f':
+      {
+	char *end;
+
+	flashStart = strtoul (optarg, &end, 0);
+
+	if (',' == *end)
+	  flashLength = strtoul (end + 1, &end, 0);
+
+	if (('\0' != *end) || (0 == flashLength))
+	  {
+	    cerr << "ERROR: Bad flash region " << optarg << endl;
+	    usage (cerr);
+	    return EXIT_FAILURE;
+	  }
+      }
+
+      break;
+
     case '?':
     case ':':
       usage (cerr);
@@ -234,18 +313,60 @@ main (int   argc,
   // is a global and can be modified if we ever invoke the getopt framework
   // again (for example in starting a target).
   nextArg = optind;
-  if (((argc - nextArg) != 1 && !from_stdin)
-      || coreName == nullptr)
+  int numConns = (from_stdin ? 1 : 0) + (sockPath != nullptr ? 1 : 0)
+    + (shmName != nullptr ? 1 : 0);
+  if (((argc - nextArg) != 1 && (numConns == 0))
+      || (numConns > 1)
+      || coreName == nullptr
+      || ((numWorkers > 0) && (numConns > 0)))
     {
       usage (cerr);
       return  EXIT_FAILURE;
     }
 
+  if (numWorkers > 0)
+    {
+      // Each session needs a core of its own.  The GDB simulator is a
+      // single global instance, and all cores would write the same VCD
+      // file.
+      if (0 == strcasecmp ("GDBSIM", coreName))
+	{
+	  cerr << "ERROR: --sessions is not supported for " << coreName
+	       << endl;
+	  return  EXIT_FAILURE;
+	}
+
+      if (traceFlags->traceVcd ())
+	{
+	  cerr << "ERROR: --sessions cannot be used with VCD tracing" << endl;
+	  return  EXIT_FAILURE;
+	}
+
+      port = atoi (argv[nextArg]);
+      SessionManager  sessions (port, numWorkers,
+				[coreName] (TraceFlags *flags) -> ITarget *
+				{
+				  // Forget any core from a previous session
+				  threadCpu = nullptr;
+				  threadCpu = createCpu (coreName, flags);
+				  return  threadCpu;
+				},
+				traceFlags);
+
+      if (flashLength > 0)
+	sessions.flashRegion (flashStart, flashLength);
+
+      // Only returns on failure
+      return  sessions.run ();
+    }
+
   // Create the cpu model.
   globalCpu = createCpu (coreName, traceFlags);
   if (globalCpu == nullptr)
     return  EXIT_FAILURE;
 
+  threadCpu = globalCpu;
+
   AbstractConnection *conn;
   GdbServer::KillBehaviour killBehaviour;
   if (from_stdin)
@@ -253,6 +374,16 @@ main (int   argc,
       conn = new StreamConnection (traceFlags);
       killBehaviour = GdbServer::KillBehaviour::EXIT_ON_KILL;
     }
+  else if (sockPath != nullptr)
+    {
+      conn = new UnixConnection (sockPath, traceFlags);
+      killBehaviour = GdbServer::KillBehaviour::RESET_ON_KILL;
+    }
+  else if (shmName != nullptr)
+    {
+      conn = new ShmConnection (shmName, traceFlags);
+      killBehaviour = GdbServer::KillBehaviour::RESET_ON_KILL;
+    }
   else
     {
       port = atoi (argv[nextArg]);
@@ -266,6 +397,9 @@ main (int   argc,
                                         killBehaviour);
   globalCpu->gdbServer (gdbServer);
 
+  if (flashLength > 0)
+    gdbServer->flashRegion (flashStart, flashLength);
+
   // Run the GDB server.
 
   int ret = gdbServer->rspServer ();
@@ -289,8 +423,8 @@ double
 sc_time_stamp ()
 {
   // If we are called before cpu has been constructed, return 0.0
-  if (globalCpu != nullptr)
-    return globalCpu->timeStamp ();
+  if (threadCpu != nullptr)
+    return threadCpu->timeStamp ();
   else
     return 0.0;
 }
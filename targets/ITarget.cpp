@@ -26,6 +26,25 @@
 #include "ITarget.h"
 
 
+//! Lock for the Verilator runtime
+
+//! Each session has its own Verilated model, but the Verilator runtime is
+//! not built thread safe and its global state (the scope table, trace and
+//! $finish flags, $display output) is shared by all models.  So a model
+//! must only be constructed, evaluated or destroyed while holding this.
+
+//! @return  The one lock shared by all Verilator targets.
+
+std::mutex &
+ITarget::verilatorMutex ()
+{
+  static std::mutex  m;
+
+  return  m;
+
+}	// ITarget::verilatorMutex ()
+
+
 //! Output operator for ResumeType enumeration
 
 //! @param[in] s  The stream to output to.
@@ -26,6 +26,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <mutex>
 
 #include "RegisterSizes.h"
 
@@ -33,6 +34,7 @@
 
 class TraceFlags;
 class GdbServer;
+class MemoryMap;
 
 
 //! Generic interface class for GDB RSP server targets.
@@ -121,6 +123,11 @@ class ITarget
 			      const uint8_t * buffer,
 			      const std::size_t  size) = 0;
 
+  // Describe the memory the target has.  Return value indicates whether the
+  // target knows its memory layout.
+
+  virtual bool  memoryMap (MemoryMap & map) const = 0;
+
   // Insert and remove a matchpoint (breakpoint or watchpoint) at the given
   // address.  Return value indicates whether the operation was successful.
 
@@ -141,6 +148,7 @@ class ITarget
   // Verilator support
 
   virtual double timeStamp () = 0;
+  static std::mutex & verilatorMutex ();
 
 private:
 
@@ -211,6 +211,22 @@ GdbSim::write (const uint32_t  addr,
 }	// GdbSim::write ()
 
 
+//! Describe the memory
+
+//! The GDB simulator allocates memory as the program uses it, so there is
+//! no fixed layout to describe.
+
+//! @param[out] map  The memory map to fill in
+//! @return  FALSE, since the memory layout is not known.
+
+bool
+GdbSim::memoryMap (MemoryMap & map __attribute__ ((unused)) ) const
+{
+  return false;
+
+}	// GdbSim::memoryMap ()
+
+
 //! Insert a matchpoint
 
 //! Wrapper for the implementation class.
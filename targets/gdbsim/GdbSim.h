@@ -75,6 +75,10 @@ class GdbSim final : public ITarget
 			      const uint8_t * buffer,
 			      const std::size_t  size);
 
+  // Describe the memory the target has.
+
+  virtual bool  memoryMap (MemoryMap & map) const;
+
   // Insert and remove a matchpoint (breakpoint or watchpoint) at the given
   // address.  Return value indicates whether the operation was successful.
 
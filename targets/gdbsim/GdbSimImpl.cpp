@@ -43,6 +43,8 @@
 
 GdbSimImpl::GdbSimImpl (const TraceFlags *flags)
   : mFlags (flags),
+    mServer (nullptr),
+    mBreakFlag (nullptr),
     mHaveReset (false)
 {
   reset (ITarget::ResetType::COLD);
@@ -366,7 +368,8 @@ GdbSimImpl::command (const std::string  cmd __attribute__ ((unused)),
 void
 GdbSimImpl::gdbServer (GdbServer *server)
 {
-  mServer = server;
+  mServer    = server;
+  mBreakFlag = server->breakFlag ();
 }	// GdbSimImpl::gdbServer ()
 
 
@@ -490,9 +493,13 @@ GdbSimImpl::doRunToBreak (std::chrono::duration <double> timeout)
       if (res != ITarget::ResumeRes::STEPPED)
         return res;
 
-      // Have we been running too long?
+      // Have we been running too long, or has GDB sent a break? Either way
+      // the server sorts out which.
       if (haveTimeout && (std::chrono::system_clock::now () > timeout_end))
         return ITarget::ResumeRes::TIMEOUT;
+
+      if (mBreakFlag && mBreakFlag->load (std::memory_order_relaxed))
+        return ITarget::ResumeRes::TIMEOUT;
     }
   while (true);
 }
@@ -23,6 +23,7 @@
 #ifndef GDBSIM_IMPL_H
 #define GDBSIM_IMPL_H
 
+#include <atomic>
 #include <cstdint>
 #include <fstream>
 
@@ -110,6 +111,10 @@ class GdbSimImpl final
 
   GdbServer * mServer;
 
+  //! The server's break flag, polled while running
+
+  const std::atomic<bool> * mBreakFlag;
+
   //! Have we reset before?
 
   bool mHaveReset;
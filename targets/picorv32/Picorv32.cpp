@@ -24,6 +24,7 @@
 #include <cstdint>
 #include <iostream>
 
+#include "MemoryMap.h"
 #include "Picorv32.h"
 #include "Picorv32Impl.h"
 #include "Vtestbench_testbench.h"
@@ -47,6 +48,7 @@ static const size_t RUN_SAMPLE_PERIOD = 10000;
 Picorv32::Picorv32 (TraceFlags * flags) :
   ITarget (flags),
   mServer (nullptr),
+  mBreakFlag (nullptr),
   mFlags (flags)
 {
   mPicorv32Impl = new Picorv32Impl (flags);
@@ -69,6 +71,7 @@ ITarget::ResumeRes
 Picorv32::resume (ResumeType step,
         std::chrono::duration <double> timeout)
 {
+  bool haveTimeout = duration <double>::zero () != timeout;
   time_point <system_clock, duration <double> > timeout_end =
     system_clock::now () + timeout;
 
@@ -93,7 +96,10 @@ Picorv32::resume (ResumeType step,
         }
       }
 
-      if (timeout_end < system_clock::now ())
+      // A break from GDB is treated like a timeout, leaving the server to
+      // report the interrupt.
+      if ((haveTimeout && (timeout_end < system_clock::now ()))
+          || (mBreakFlag && mBreakFlag->load (std::memory_order_relaxed)))
       {
         return ResumeRes::TIMEOUT;
       }
@@ -184,6 +190,14 @@ Picorv32::write (const uint32_t addr,
   return i;
 }
 
+bool
+Picorv32::memoryMap (MemoryMap & map) const
+{
+  map.clear ();
+  map.add (MemoryMap::Type::RAM, 0, MEM_SIZE);
+  return true;
+}
+
 bool
 Picorv32::insertMatchpoint (const uint32_t  addr, const MatchType matchType)
 {
@@ -209,7 +223,8 @@ Picorv32::command (const std::string cmd, std::ostream & stream)
 void
 Picorv32::gdbServer (GdbServer *server)
 {
-  mServer = server;
+  mServer    = server;
+  mBreakFlag = server->breakFlag ();
 }
 
 
@@ -23,6 +23,8 @@
 #ifndef PICORV32_H
 #define PICORV32_H
 
+#include <atomic>
+
 #include "ITarget.h"
 
 
@@ -75,6 +77,10 @@ class Picorv32 final : public ITarget
 			      const uint8_t * buffer,
 			      const std::size_t  size);
 
+  // Describe the memory the target has.
+
+  virtual bool  memoryMap (MemoryMap & map) const;
+
   // Insert and remove a matchpoint (breakpoint or watchpoint) at the given
   // address.  Return value indicates whether the operation was successful.
 
@@ -99,10 +105,19 @@ class Picorv32 final : public ITarget
 
  private:
 
+  //! Size of the testbench memory, which starts at address zero. Must match
+  //! testbench.v.
+
+  static const uint32_t  MEM_SIZE = 128 * 1024;
+
   //! The server using us. @todo Should not have this in this class.
 
   GdbServer *mServer;
 
+  //! The server's break flag, polled while running
+
+  const std::atomic<bool> *mBreakFlag;
+
   //! The traceflags we were given. @todo Should not have this in this class.
 
   TraceFlags *mFlags;
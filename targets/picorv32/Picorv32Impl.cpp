@@ -21,7 +21,9 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <cstdint>
+#include <mutex>
 
+#include "ITarget.h"
 #include "Picorv32Impl.h"
 #include "Vtestbench__Syms.h"
 
@@ -39,6 +41,8 @@ Picorv32Impl::Picorv32Impl (TraceFlags * flags) :
   mClk (0),
   mInstr (0)
 {
+  std::lock_guard<std::mutex>  lock (ITarget::verilatorMutex ());
+
   mCpu = new Vtestbench;
 
   // Open VCD file if requested
@@ -59,6 +63,8 @@ Picorv32Impl::Picorv32Impl (TraceFlags * flags) :
 
 Picorv32Impl::~Picorv32Impl ()
 {
+  std::lock_guard<std::mutex>  lock (ITarget::verilatorMutex ());
+
   // Close VCD file if requested
 
   if (mWantVcd)
@@ -98,11 +104,13 @@ Picorv32Impl::getInstrCount () const
 }	// Picorv32Impl::getInstrCount ()
 
 
-// ! Step one single clock of the processor
+// ! Step one single clock of the processor, holding the Verilator lock
 
 void
 Picorv32Impl::clockStep ()
 {
+  std::lock_guard<std::mutex>  lock (ITarget::verilatorMutex ());
+
   mCpu->clk = mClk;
   mCpu->eval ();
   mClk++;
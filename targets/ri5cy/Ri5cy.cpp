@@ -21,6 +21,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "GdbServer.h"
+#include "MemoryMap.h"
 #include "Ri5cy.h"
 #include "Ri5cyImpl.h"
 #include "TraceFlags.h"
@@ -211,6 +212,21 @@ Ri5cy::write (const uint32_t  addr,
 }	// Ri5cy::write ()
 
 
+//! Describe the memory
+
+//! Wrapper for the implementation class.
+
+//! @param[out] map  The memory map to fill in
+//! @return  TRUE if the memory layout is known, FALSE otherwise.
+
+bool
+Ri5cy::memoryMap (MemoryMap & map) const
+{
+  return mRi5cyImpl->memoryMap (map);
+
+}	// Ri5cy::memoryMap ()
+
+
 //! Insert a matchpoint
 
 //! Wrapper for the implementation class.
@@ -23,9 +23,11 @@
 #include <iostream>
 #include <cstdint>
 #include <cstdlib>
+#include <mutex>
 #include <sstream>
 
 #include "GdbServer.h"
+#include "MemoryMap.h"
 #include "Ri5cyImpl.h"
 #include "TraceFlags.h"
 #include "verilated_vcd_c.h"
@@ -49,23 +51,28 @@ using std::ostringstream;
 
 Ri5cyImpl::Ri5cyImpl (const TraceFlags * flags) :
   mServer (nullptr),
+  mBreakFlag (nullptr),
   mFlags (flags),
   mCoreHalted (false),
   mCycleCnt (0),
   mInstrCnt (0),
   mCpuTime (0)
 {
-  mCpu = new Vtop;
+  {
+    std::lock_guard<std::mutex>  lock (verilatorMutex ());
 
-  // Open VCD file if requested
+    mCpu = new Vtop;
 
-  if (mFlags->traceVcd ())
-    {
-      Verilated::traceEverOn (true);
-      mTfp = new VerilatedVcdC;
-      mCpu->trace (mTfp, 99);
-      mTfp->open ("gdbserver.vcd");
-    }
+    // Open VCD file if requested
+
+    if (mFlags->traceVcd ())
+      {
+	Verilated::traceEverOn (true);
+	mTfp = new VerilatedVcdC;
+	mCpu->trace (mTfp, 99);
+	mTfp->open ("gdbserver.vcd");
+      }
+  }
 
   // Reset and halt the model
 
@@ -80,6 +87,8 @@ Ri5cyImpl::Ri5cyImpl (const TraceFlags * flags) :
 
 Ri5cyImpl::~Ri5cyImpl ()
 {
+  std::lock_guard<std::mutex>  lock (verilatorMutex ());
+
   // Close VCD file if requested
 
   if (mFlags->traceVcd ())
@@ -362,6 +371,24 @@ Ri5cyImpl::write (const uint32_t  addr,
 }	// Ri5cyImpl::write ()
 
 
+//! Describe the memory
+
+//! There is just the one RAM in top.sv. Nothing outside it can be read or
+//! written meaningfully.
+
+//! @param[out] map  The memory map to fill in
+//! @return  TRUE, since we always know the memory layout.
+
+bool
+Ri5cyImpl::memoryMap (MemoryMap & map) const
+{
+  map.clear ();
+  map.add (MemoryMap::Type::RAM, RAM_START, RAM_SIZE);
+  return  true;
+
+}	// Ri5cyImpl::memoryMap ()
+
+
 //! Insert a matchpoint (breakpoint or watchpoint)
 
 //! @todo
@@ -430,7 +457,8 @@ Ri5cyImpl::command (const std::string  cmd __attribute__ ((unused)),
 void
 Ri5cyImpl::gdbServer (GdbServer *server)
 {
-  mServer = server;
+  mServer    = server;
+  mBreakFlag = server->breakFlag ();
 
 }	// Ri5cyImpl::gdbServer ()
 
@@ -452,11 +480,14 @@ Ri5cyImpl::timeStamp ()
 //! Helper method to clock the model
 
 //! Clock the model through one full cycle, saving to VCD if requested.  It is
-//! up to the caller to set any other signals.
+//! up to the caller to set any other signals.  We take the Verilator lock
+//! for each cycle, so other sessions' models can run between our cycles.
 
 void
 Ri5cyImpl::clockModel ()
 {
+  std::lock_guard<std::mutex>  lock (verilatorMutex ());
+
   mCpu->clk_i = 0;
   mCpu->eval ();
 
@@ -702,10 +733,12 @@ Ri5cyImpl::runToBreak (duration <double>  timeout)
   newDbgCtrl = readDebugReg (DBG_CTRL) & ~(DBG_CTRL_SSTE | DBG_CTRL_HALT);
   writeDebugReg (DBG_CTRL, newDbgCtrl);
 
-  // @todo this is a type of waitForHalt
+  // @todo this is a type of waitForHalt. A break from GDB is treated like
+  // a timeout, leaving the server to report the interrupt.
 
   while (DBG_CTRL_HALT != (readDebugReg (DBG_CTRL) & DBG_CTRL_HALT))
-    if (haveTimeout && (system_clock::now () > timeout_end))
+    if ((haveTimeout && (system_clock::now () > timeout_end))
+	|| (mBreakFlag && mBreakFlag->load (std::memory_order_relaxed)))
       {
 	haltModel ();
 	return ITarget::ResumeRes::TIMEOUT;
@@ -23,6 +23,7 @@
 #ifndef RI5CY_IMPL_H
 #define RI5CY_IMPL_H
 
+#include <atomic>
 #include <cstdint>
 
 #include "ITarget.h"
@@ -72,6 +73,10 @@ class Ri5cyImpl final
 		      const uint8_t * buffer,
 		      const std::size_t  size);
 
+  // Describe the memory the target has.
+
+  bool  memoryMap (MemoryMap & map) const;
+
   // Insert and remove a matchpoint (breakpoint or watchpoint) at the given
   // address.  Return value indicates whether the operation was successful.
 
@@ -104,6 +109,11 @@ private:
 
   const int RESET_CYCLES = 5;
 
+  // The memory in top.sv, with ADDR_WIDTH 22
+
+  const uint32_t RAM_START = 0x00000000;	//!< Start of ram_i
+  const uint32_t RAM_SIZE  = 0x00400000;	//!< Size of ram_i
+
   // Debug registers
 
   const uint16_t DBG_CTRL    = 0x0000;	//!< Debug control
@@ -151,6 +161,10 @@ private:
 
   GdbServer * mServer;
 
+  //! The server's break flag, polled while running
+
+  const std::atomic<bool> * mBreakFlag;
+
   //! The trace flags with which we were called.
 
   const TraceFlags * mFlags;
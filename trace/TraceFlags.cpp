@@ -140,6 +140,7 @@ TraceFlags::TraceFlags () :
       sFlagInfo.push_back ({ TRACE_BREAK,  "break"  });
       sFlagInfo.push_back ({ TRACE_VCD,    "vcd"    });
       sFlagInfo.push_back ({ TRACE_SILENT, "silent" });
+      sFlagInfo.push_back ({ TRACE_STATS,  "stats"  });
     }
 }	// TraceFlags::TraceFlags ()
 
@@ -212,6 +213,18 @@ TraceFlags::traceSilent () const
 }	// TraceFlags::traceSilent ()
 
 
+//! Is reporting of packet statistics enabled?
+
+//! @return  TRUE if the STATS tracing flag is set, FALSE otherwise
+
+bool
+TraceFlags::traceStats () const
+{
+  return (mFlags & TRACE_STATS) == TRACE_STATS;
+
+}	// TraceFlags::traceStats ()
+
+
 //! Is this a real flag
 
 //! @param[in] flagName  Case insensitive name to check.